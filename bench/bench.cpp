@@ -0,0 +1,150 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "value.hpp"
+#include "read.hpp"
+#include "eval.hpp"
+#include "gc.hpp"
+
+using namespace std;
+using namespace crisp;
+
+// Runs the classic interpreter workloads through doRead/doEval and prints
+// one tab separated line per benchmark:
+//
+//   benchmark  runs  seconds  allocations  bytes_allocated  ops  ops_per_sec
+//
+// allocations and bytes_allocated come from the collector's statistics
+// (values, and bytes of values and environments). An op is one run of the
+// workload, except for the reader where it's one byte of input. Pass a
+// scale factor to run every benchmark more (or fewer) times.
+
+namespace { // unnamed namespace
+
+struct Benchmark{
+  const char* name;
+  vector<string> definitions;
+  string expression;
+  string expected; // what the expression prints as
+  long runs;
+};
+
+const vector<Benchmark> Benchmarks = {
+  {"fib", {
+    "(define fib (lambda (n) (if (< n 2) n (add (fib (sub n 1)) (fib (sub n 2))))))",
+   }, "(fib 25)", "75025", 5},
+  {"tak", {
+    "(define tak (lambda (x y z) (if (< y x) (tak (tak (sub x 1) y z) (tak (sub y 1) z x) (tak (sub z 1) x y)) z)))",
+   }, "(tak 18 12 6)", "7", 20},
+  {"ackermann", {
+    "(define ack (lambda (m n) (if (= m 0) (add n 1) (if (= n 0) (ack (sub m 1) 1) (ack (sub m 1) (ack m (sub n 1)))))))",
+   }, "(ack 3 6)", "509", 10},
+  {"nqueens", {
+    "(define safe? (lambda (row dist placed) (if (null? placed) #t (if (= (car placed) (add row dist)) #f (if (= (car placed) (sub row dist)) #f (if (= (car placed) row) #f (safe? row (add dist 1) (cdr placed))))))))",
+    "(define try (lambda (row n k placed) (if (= row 0) 0 (add (if (safe? row 1 placed) (queens n (sub k 1) (cons row placed)) 0) (try (sub row 1) n k placed)))))",
+    "(define queens (lambda (n k placed) (if (= k 0) 1 (try n n k placed))))",
+   }, "(queens 8 8 (quote ()))", "92", 5},
+  {"list", {
+    "(define build (lambda (n acc) (if (= n 0) acc (build (sub n 1) (cons n acc)))))",
+    "(define rev (lambda (l acc) (if (null? l) acc (rev (cdr l) (cons (car l) acc)))))",
+   }, "(car (rev (build 10000 (quote ())) (quote ())))", "10000", 50},
+  {"deep-recursion", {
+    "(define count (lambda (n) (if (= n 0) 0 (add 1 (count (sub n 1))))))",
+   }, "(count 100000)", "100000", 10},
+};
+
+Value* parse(const string& input){
+  istringstream ss{input};
+  return doRead(ss);
+}
+
+string printed(Value* value){
+  StringPort port;
+  print(value, port);
+  return port.str();
+}
+
+// a single line of nested lists with symbols, numbers, strings and quotes
+string readerInput(int items){
+  string input = "(";
+  for(int i = 0; i < items; ++i){
+    input += "(define (item-" + to_string(i % 100) + " x) (list 'quoted " +
+             to_string(i) + " \"string " + to_string(i) + "\" #t (nested (deeper x))))";
+  }
+  return input + ")";
+}
+
+struct Measurement{
+  double seconds;
+  size_t allocations;
+  size_t bytes_allocated;
+};
+
+template<typename F>
+Measurement measure(long runs, F run){
+  auto before = gc::statistics();
+  auto start = chrono::steady_clock::now();
+  for(long i = 0; i < runs; ++i){
+    run();
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  auto after = gc::statistics();
+  return Measurement{elapsed.count(),
+                     after.objects_allocated - before.objects_allocated,
+                     after.bytes_allocated - before.bytes_allocated};
+}
+
+void report(const string& name, long runs, const Measurement& m, double ops){
+  cout << name << "\t" << runs << "\t" << m.seconds << "\t" << m.allocations << "\t"
+       << m.bytes_allocated << "\t" << static_cast<long>(ops) << "\t"
+       << static_cast<long>(ops / m.seconds) << endl;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  double scale = argc > 1 ? atof(argv[1]) : 1.0;
+  initEval();
+  cout << "benchmark\truns\tseconds\tallocations\tbytes_allocated\tops\tops_per_sec" << endl;
+
+  bool failed = false;
+  for(auto& benchmark : Benchmarks){
+    for(auto& definition : benchmark.definitions){
+      doEval(parse(definition));
+    }
+    long runs = max(1L, static_cast<long>(benchmark.runs * scale));
+    Value* result = nullptr;
+    gc::Root result_root{result};
+    auto m = measure(runs, [&]{ result = doEval(parse(benchmark.expression)); });
+    if(printed(result) != benchmark.expected){
+      cerr << benchmark.name << ": expected " << benchmark.expected
+           << " but got " << printed(result) << endl;
+      failed = true;
+    }
+    report(benchmark.name, runs, m, runs);
+  }
+
+  string input = readerInput(2000);
+  long runs = max(1L, static_cast<long>(10 * scale));
+  auto m = measure(runs, [&]{ parse(input); });
+  report("reader", runs, m, static_cast<double>(runs) * input.size());
+
+  // reading should be linear in the size of a datum: the same kind of
+  // input eight times as long should read at about the same bytes/sec
+  string small = readerInput(500);
+  string large = readerInput(4000);
+  auto small_m = measure(runs * 8, [&]{ parse(small); });
+  auto large_m = measure(runs, [&]{ parse(large); });
+  report("reader-scaling-1x", runs * 8, small_m, 8.0 * runs * small.size());
+  report("reader-scaling-8x", runs, large_m, static_cast<double>(runs) * large.size());
+  double slowdown = (large_m.seconds / large.size()) / (small_m.seconds / small.size());
+  if(slowdown > 4){
+    cerr << "reader: 8x the input read " << slowdown << "x slower per byte" << endl;
+    failed = true;
+  }
+
+  return failed ? 1 : 0;
+}
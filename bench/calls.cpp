@@ -0,0 +1,57 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+
+#include "value.hpp"
+#include "read.hpp"
+#include "eval.hpp"
+#include "compile.hpp"
+#include "vm.hpp"
+
+using namespace std;
+using namespace crisp;
+
+namespace { // unnamed namespace
+
+// (name ... (name x suffix) ... suffix), calling name n times
+string nest(const string& name, const string& suffix, int n){
+  string form = "x";
+  for(int i = 0; i < n; ++i){
+    form = "(" + name + " " + form + suffix + ")";
+  }
+  return form;
+}
+
+Value* parse(const string& input){
+  istringstream ss{input};
+  return doRead(ss);
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  long iterations = argc > 1 ? atol(argv[1]) : 2000;
+  initEval();
+  // every call to (calls1000 x) makes 1000 calls to a procedure of two
+  // arguments through three levels of procedures of one
+  doEval(parse("(define id2 (lambda (x y) x))"));
+  doEval(parse("(define calls10 (lambda (x) " + nest("id2", " 1", 10) + "))"));
+  doEval(parse("(define calls100 (lambda (x) " + nest("calls10", "", 10) + "))"));
+  doEval(parse("(define calls1000 (lambda (x) " + nest("calls100", "", 10) + "))"));
+  Value* code = compile(parse("(calls1000 0)"), &GlobalEnvironment);
+  gc::Root code_root{code};
+
+  auto start = chrono::steady_clock::now();
+  for(long i = 0; i < iterations; ++i){
+    execute(code, &GlobalEnvironment);
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+  // each iteration is 1111 calls: 1000 to id2, 100 to calls10, 10 to
+  // calls100 and one to calls1000
+  double calls = 1111.0 * iterations;
+  cout << "calls: " << static_cast<long>(calls) << "\n"
+       << "seconds: " << elapsed.count() << "\n"
+       << "calls/sec: " << static_cast<long>(calls / elapsed.count()) << "\n";
+  return 0;
+}
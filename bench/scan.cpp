@@ -0,0 +1,86 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "value.hpp"
+#include "read.hpp"
+#include "eval.hpp"
+#include "scan.hpp"
+
+using namespace std;
+using namespace crisp;
+
+// Reads the same data file at every scan level the processor supports and
+// prints throughput in MB/s for each, scalar first: the lexer on its own,
+// then the whole reader. Pass the number of times to read it.
+
+namespace { // unnamed namespace
+
+// the kind of input bulk loading sees: long symbols and strings, comments
+// and indentation
+string dataFile(int records){
+  string input;
+  for(int i = 0; i < records; ++i){
+    input += ";; record " + to_string(i) + ", generated for the scanning benchmark\n"
+             "(record-with-a-descriptive-name\n"
+             "    (identifier customer-account-" + to_string(i) + "-primary-residence)\n"
+             "    (description \"a reasonably long string describing record number " +
+             to_string(i) + " in some detail, as data files tend to\")\n"
+             "    (values " + to_string(i) + " " + to_string(i * 7) + " #t #f))\n";
+  }
+  return input;
+}
+
+template<typename F>
+double megabytesPerSecond(const string& input, long runs, F read){
+  read(); // warm up
+  auto start = chrono::steady_clock::now();
+  for(long i = 0; i < runs; ++i){
+    read();
+  }
+  chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+  return runs * input.size() / elapsed.count() / 1e6;
+}
+
+// tokens only, no values
+void lex(const string& input){
+  // the input ends in a newline, which the lexer would take as the start
+  // of another token
+  const char* end = input.data() + input.size() - 1;
+  for(const char* rest = input.data(); rest != end; rest = get<2>(readToken(rest, end))){
+  }
+}
+
+void read(const string& input){
+  MemorySource source{input.data(), input.size()};
+  Reader reader{source};
+  while(reader.next()){
+  }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+  long runs = argc > 1 ? atol(argv[1]) : 20;
+  initEval();
+  string input = dataFile(5000);
+  ScanLevel best = bestScanLevel();
+  double scalar_lexer = 0;
+  double scalar_reader = 0;
+  for(auto level : {ScanLevel::SCALAR, ScanLevel::SSE2, ScanLevel::AVX2}){
+    if(level > best){
+      break;
+    }
+    setScanLevel(level);
+    double lexer = megabytesPerSecond(input, runs, [&]{ lex(input); });
+    double reader = megabytesPerSecond(input, runs, [&]{ read(input); });
+    if(level == ScanLevel::SCALAR){
+      scalar_lexer = lexer;
+      scalar_reader = reader;
+    }
+    cout << scanLevelName(level) << ": lexer " << lexer << " MB/s ("
+         << lexer / scalar_lexer << "x scalar), reader " << reader << " MB/s ("
+         << reader / scalar_reader << "x scalar)\n";
+  }
+  return 0;
+}
@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+#include "compile.hpp"
+#include "value.hpp"
+#include "eval.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+// the special form a head symbol refers to, if any
+SpecialForm specialForm(const Compiler& compiler, Value* head){
+  if(typeOf(head) != Value::Type::SYMBOL || compiler.isLocal(head)){
+    return nullptr;
+  }
+  auto binding = compiler.environment()->getBinding(head);
+  if(!binding || typeOf(binding) != Value::Type::SPECIAL_FORM){
+    return nullptr;
+  }
+  return binding->special_form;
+}
+
+// The symbols that mean something in a quasiquote template, looked up once
+// per template.
+struct Template{
+  Value* quasiquote;
+  Value* unquote;
+  Value* splice;
+};
+
+bool isPair(Value* value){
+  return value && typeOf(value) == Value::Type::PAIR && value != EmptyList;
+}
+
+// A special form gets the rest of its list as is, so it checks that it's a
+// proper list of between min and max elements before taking it apart.
+void checkArguments(Value* args, size_t min, size_t max, const char* message){
+  size_t count = 0;
+  for(; isPair(args); args = cdr(args)){
+    ++count;
+  }
+  if(args != EmptyList || count < min || count > max){
+    throw EvaluationError(message);
+  }
+}
+
+// whether value is (keyword x)
+bool isForm(Value* value, Value* keyword){
+  return isPair(value) && car(value) == keyword && isPair(cdr(value)) &&
+         cdr(cdr(value)) == EmptyList;
+}
+
+bool isTemplateForm(const Template& symbols, Value* value){
+  return isForm(value, symbols.quasiquote) || isForm(value, symbols.unquote) ||
+         isForm(value, symbols.splice);
+}
+
+// whether anything in tmpl is evaluated, depth being how many quasiquotes
+// deep it's nested inside the outermost one
+bool hasHoles(const Template& symbols, Value* tmpl, size_t depth){
+  // down the list iteratively, only into elements recursively
+  for(; isPair(tmpl); tmpl = cdr(tmpl)){
+    if(isForm(tmpl, symbols.unquote) || isForm(tmpl, symbols.splice)){
+      return depth == 0 || hasHoles(symbols, car(cdr(tmpl)), depth - 1);
+    }
+    if(isForm(tmpl, symbols.quasiquote)){
+      return hasHoles(symbols, car(cdr(tmpl)), depth + 1);
+    }
+    if(hasHoles(symbols, car(tmpl), depth)){
+      return true;
+    }
+  }
+  return false;
+}
+
+void compileTemplate(Compiler& compiler, const Template& symbols, Value* tmpl,
+                     size_t depth){
+  if(!hasHoles(symbols, tmpl, depth)){
+    compiler.emit(Opcode::CONST, compiler.constant(tmpl));
+    return;
+  }
+  if(isTemplateForm(symbols, tmpl)){
+    auto keyword = car(tmpl);
+    if(keyword == symbols.quasiquote){
+      ++depth;
+    } else if(depth == 0){
+      if(keyword == symbols.splice){
+        throw EvaluationError("Unquote-splicing can only happen inside a list.");
+      }
+      compiler.compile(car(cdr(tmpl)), false);
+      return;
+    } else {
+      --depth;
+    }
+    // a nested one is kept, with whatever holes are in it filled
+    compiler.emit(Opcode::CONST, compiler.constant(keyword));
+    compileTemplate(compiler, symbols, car(cdr(tmpl)), depth);
+    compiler.emit(Opcode::CONST, compiler.constant(EmptyList));
+    compiler.emit(Opcode::CONS);
+    compiler.emit(Opcode::CONS);
+    return;
+  }
+
+  // find where the list stops having holes; a tail like the (unquote x) in
+  // (1 unquote x), which is how (1 . ,x) reads, is a hole of its own
+  Value* shared = tmpl;
+  Value* element = tmpl;
+  for(; isPair(element) && !isTemplateForm(symbols, element); element = cdr(element)){
+    if(hasHoles(symbols, car(element), depth)){
+      shared = cdr(element);
+    }
+  }
+  if(isTemplateForm(symbols, element) && hasHoles(symbols, element, depth)){
+    shared = element;
+  }
+
+  vector<Opcode> joins;
+  for(element = tmpl; element != shared; element = cdr(element)){
+    if(depth == 0 && isForm(car(element), symbols.splice)){
+      compiler.compile(car(cdr(car(element))), false);
+      joins.push_back(Opcode::APPEND);
+    } else {
+      compileTemplate(compiler, symbols, car(element), depth);
+      joins.push_back(Opcode::CONS);
+    }
+  }
+  compileTemplate(compiler, symbols, shared, depth);
+  for(auto join = joins.rbegin(); join != joins.rend(); ++join){
+    compiler.emit(*join);
+  }
+}
+
+} // end unnamed namespace
+
+Compiler::Compiler(Compiler* enclosing, Value* formals, Environment* envt)
+    : enclosing_{enclosing}, envt_{envt}, code_{new Code{{}, {}, formals, {}, {}}},
+      scope_{}, body_start_{0} {
+  // parameters take the first slots, in order, so arguments can be bound
+  // without looking at names
+  auto& locals = code_->locals;
+  for(Value* name = formals; name != EmptyList; name = cdr(name)){
+    Value* parameter = typeOf(name) == Value::Type::PAIR ? car(name) : name;
+    if(typeOf(parameter) != Value::Type::SYMBOL){
+      throw EvaluationError("Procedure parameters must be symbols.");
+    }
+    if(find(begin(locals), end(locals), parameter) != end(locals)){
+      throw EvaluationError("Procedure parameters must be distinct.");
+    }
+    bind(parameter);
+    if(typeOf(name) != Value::Type::PAIR){
+      code_->rest = true;
+      break;
+    }
+    ++code_->required;
+  }
+}
+
+uint32_t Compiler::declare(Value* symbol){
+  for(size_t i = scope_.size(); i > body_start_; --i){
+    if(scope_[i - 1].first == symbol){
+      return scope_[i - 1].second;
+    }
+  }
+  return bind(symbol);
+}
+
+uint32_t Compiler::bind(Value* symbol){
+  auto& locals = code_->locals;
+  uint32_t slot = locals.size();
+  locals.push_back(symbol);
+  scope_.emplace_back(symbol, slot);
+  return slot;
+}
+
+bool Compiler::isLocal(Value* symbol) const {
+  uint32_t depth, slot;
+  return resolve(symbol, depth, slot);
+}
+
+// only procedures get frames, so the top level compiler never has locals
+bool Compiler::resolve(Value* symbol, uint32_t& depth, uint32_t& slot) const {
+  depth = 0;
+  for(const Compiler* c = this; c->enclosing_; c = c->enclosing_, ++depth){
+    auto& scope = c->scope_;
+    for(auto itr = scope.rbegin(); itr != scope.rend(); ++itr){
+      if(itr->first == symbol){
+        slot = itr->second;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool Compiler::isGlobal() const {
+  return envt_ == &GlobalEnvironment;
+}
+
+void Compiler::emit(Opcode op, uint32_t operand){
+  assert(operand <= MaxOperand && "operand doesn't fit in an instruction");
+  code_->instructions.push_back(encode(op, operand));
+}
+
+size_t Compiler::here() const {
+  return code_->instructions.size();
+}
+
+void Compiler::patch(size_t instruction, uint32_t target){
+  auto op = opcode(code_->instructions[instruction]);
+  code_->instructions[instruction] = encode(op, target);
+}
+
+uint32_t Compiler::constant(Value* value){
+  auto& constants = code_->constants;
+  auto itr = find(begin(constants), end(constants), value);
+  if(itr != end(constants)){
+    return itr - begin(constants);
+  }
+  if(constants.size() > MaxOperand){
+    throw EvaluationError("Too many constants in one procedure.");
+  }
+  constants.push_back(value);
+  return constants.size() - 1;
+}
+
+Value* Compiler::finish(){
+  code_->cells.resize(code_->constants.size());
+  return new Value(code_.release());
+}
+
+void Compiler::compile(Value* form, bool tail){
+  if(!form || form == EmptyList){
+    emit(Opcode::CONST, constant(form));
+    return;
+  }
+  switch(typeOf(form)){
+    case Value::Type::FIXNUM:
+    case Value::Type::BOOLEAN:
+    case Value::Type::CHARACTER:
+    case Value::Type::STRING:
+    case Value::Type::BIGNUM:{
+      emit(Opcode::CONST, constant(form));
+    } break;
+    case Value::Type::SYMBOL:{
+      compileReference(form);
+    } break;
+    case Value::Type::PAIR:{
+      auto special_form = specialForm(*this, car(form));
+      if(special_form){
+        special_form(*this, cdr(form), tail);
+      } else {
+        compileCall(form, tail);
+      }
+    } break;
+    case Value::Type::PROCEDURE:
+    case Value::Type::SPECIAL_FORM:
+    case Value::Type::CODE:{
+      throw EvaluationError("Trying to evaluate a procedure that's not in a list.");
+    } break;
+  }
+}
+
+void Compiler::compileCall(Value* form, bool tail){
+  auto head = car(form);
+  if(typeOf(head) == Value::Type::PROCEDURE){
+    emit(Opcode::CONST, constant(head));
+  } else if(typeOf(head) == Value::Type::SYMBOL || typeOf(head) == Value::Type::PAIR){
+    compile(head, false);
+  } else {
+    throw EvaluationError("Cannot evaluate a pair that doesn't start with a pair, symbol, or procedure.");
+  }
+  uint32_t argc = 0;
+  for(Value* arg = cdr(form); arg != EmptyList; arg = cdr(arg)){
+    if(typeOf(arg) != Value::Type::PAIR){
+      throw EvaluationError("Cannot call a procedure with an improper argument list.");
+    }
+    compile(car(arg), false);
+    ++argc;
+  }
+  emit(tail ? Opcode::TAIL_CALL : Opcode::CALL, argc);
+}
+
+void Compiler::compileBody(Value* body, bool tail){
+  if(body == EmptyList){
+    emit(Opcode::CONST, constant(nullptr));
+    return;
+  }
+  // internal defines are visible to the whole body
+  if(enclosing_){
+    for(Value* form = body; form != EmptyList; form = cdr(form)){
+      auto statement = car(form);
+      if(isPair(statement) && specialForm(*this, car(statement)) == Define &&
+         isPair(cdr(statement)) && typeOf(car(cdr(statement))) == Value::Type::SYMBOL){
+        declare(car(cdr(statement)));
+      }
+    }
+  }
+  for(Value* form = body; form != EmptyList; form = cdr(form)){
+    bool last = cdr(form) == EmptyList;
+    compile(car(form), tail && last);
+    if(!last){
+      emit(Opcode::POP);
+    }
+  }
+}
+
+void Compiler::compileLambda(Value* formals, Value* body){
+  Compiler compiler{this, formals, envt_};
+  compiler.compileBody(body, true);
+  compiler.emit(Opcode::RETURN);
+  emit(Opcode::CLOSURE, constant(compiler.finish()));
+}
+
+// A let inside a procedure gets fresh slots in the procedure's own frame
+// rather than being called as a lambda, so running one allocates nothing.
+// That's safe because code only ever jumps forward: a frame runs each let
+// at most once, so no two runs can share the slots. At top level there's
+// no frame, so it's still a lambda call.
+void Compiler::compileLet(Value* bindings, Value* body, bool tail){
+  if(!enclosing_){
+    Value* names = EmptyList;
+    uint32_t argc = 0;
+    for(Value* binding = bindings; binding != EmptyList; binding = cdr(binding)){
+      names = makePair(car(car(binding)), names);
+      ++argc;
+    }
+    compileLambda(reverse(names), body);
+    for(Value* binding = bindings; binding != EmptyList; binding = cdr(binding)){
+      compile(car(cdr(car(binding))), false);
+    }
+    emit(tail ? Opcode::TAIL_CALL : Opcode::CALL, argc);
+    return;
+  }
+
+  // the inits are evaluated before any of the names are in scope
+  vector<Value*> names;
+  for(Value* binding = bindings; binding != EmptyList; binding = cdr(binding)){
+    auto name = car(car(binding));
+    if(typeOf(name) != Value::Type::SYMBOL){
+      throw EvaluationError("Procedure parameters must be symbols.");
+    }
+    if(find(begin(names), end(names), name) != end(names)){
+      throw EvaluationError("Procedure parameters must be distinct.");
+    }
+    names.push_back(name);
+    compile(car(cdr(car(binding))), false);
+  }
+
+  auto scope_size = scope_.size();
+  auto body_start = body_start_;
+  body_start_ = scope_size;
+  for(auto name : names){
+    bind(name);
+  }
+  // the last init is on top of the stack
+  for(auto name = names.rbegin(); name != names.rend(); ++name){
+    compileAssignment(*name);
+    emit(Opcode::POP);
+  }
+  compileBody(body, tail);
+  scope_.resize(scope_size);
+  body_start_ = body_start;
+}
+
+// Locals too deeply nested or too numerous for an operand still get their
+// exact address, from a constant. Looking them up by name wouldn't do: a
+// let's slots are in the enclosing frame, which can have several locals
+// of the same name.
+void Compiler::compileReference(Value* symbol){
+  uint32_t depth, slot;
+  if(resolve(symbol, depth, slot)){
+    if(depth <= MaxDepth && slot <= MaxSlot){
+      emit(Opcode::LOCAL_REF, address(depth, slot));
+    } else {
+      emit(Opcode::FAR_REF, constant(makeFixnum(farAddress(depth, slot))));
+    }
+  } else if(!isGlobal()){
+    emit(Opcode::ENVT_REF, constant(symbol));
+  } else {
+    emit(Opcode::GLOBAL_REF, constant(symbol));
+  }
+}
+
+void Compiler::compileDefinition(Value* symbol){
+  if(enclosing_){
+    declare(symbol);
+    // defining into a frame just fills the slot set aside for the name
+    compileAssignment(symbol);
+  } else if(!isGlobal()){
+    emit(Opcode::ENVT_DEFINE, constant(symbol));
+  } else {
+    emit(Opcode::GLOBAL_DEFINE, constant(symbol));
+  }
+}
+
+void Compiler::compileAssignment(Value* symbol){
+  uint32_t depth, slot;
+  if(resolve(symbol, depth, slot)){
+    if(depth <= MaxDepth && slot <= MaxSlot){
+      emit(Opcode::LOCAL_SET, address(depth, slot));
+    } else {
+      emit(Opcode::FAR_SET, constant(makeFixnum(farAddress(depth, slot))));
+    }
+  } else if(!isGlobal()){
+    emit(Opcode::ENVT_SET, constant(symbol));
+  } else {
+    emit(Opcode::GLOBAL_SET, constant(symbol));
+  }
+}
+
+Value* compile(Value* input, Environment* envt){
+  Compiler compiler{nullptr, EmptyList, envt};
+  compiler.compile(input, true);
+  compiler.emit(Opcode::RETURN);
+  return compiler.finish();
+}
+
+/***** Special Forms *****/
+void Quote(Compiler& compiler, Value* input, bool) {
+  checkArguments(input, 1, 1, "Quote takes exactly one argument.");
+  compiler.emit(Opcode::CONST, compiler.constant(car(input)));
+}
+
+void Define(Compiler& compiler, Value* input, bool) {
+  checkArguments(input, 2, 2, "Define takes a name and a value.");
+  if(typeOf(car(input)) != Value::Type::SYMBOL){
+    throw EvaluationError("Can only define symbols.");
+  }
+  compiler.compile(car(cdr(input)), false);
+  // leaves null, since define has no printed result
+  compiler.compileDefinition(car(input));
+}
+
+void Set(Compiler& compiler, Value* input, bool) {
+  checkArguments(input, 2, 2, "Set! takes a name and a value.");
+  if(typeOf(car(input)) != Value::Type::SYMBOL){
+    throw EvaluationError("Can only set symbols.");
+  }
+  compiler.compile(car(cdr(input)), false);
+  // leaves null, since set! has no printed result
+  compiler.compileAssignment(car(input));
+}
+
+void If(Compiler& compiler, Value* input, bool tail) {
+  checkArguments(input, 2, 3, "If takes a condition, a consequent and maybe an alternative.");
+  compiler.compile(car(input), false);
+  auto jump_to_alternative = compiler.here();
+  compiler.emit(Opcode::JUMP_IF_FALSE);
+  compiler.compile(car(cdr(input)), tail);
+  auto jump_to_end = compiler.here();
+  compiler.emit(Opcode::JUMP);
+  compiler.patch(jump_to_alternative, compiler.here());
+  if(cdr(cdr(input)) == EmptyList){
+    compiler.emit(Opcode::CONST, compiler.constant(nullptr));
+  } else {
+    compiler.compile(car(cdr(cdr(input))), tail);
+  }
+  compiler.patch(jump_to_end, compiler.here());
+}
+
+// (let ((x 1) (y 2)) body...) means ((lambda (x y) body...) 1 2)
+void Let(Compiler& compiler, Value* input, bool tail) {
+  checkArguments(input, 1, SIZE_MAX, "Let takes a list of bindings and a body.");
+  checkArguments(car(input), 0, SIZE_MAX, "Let takes a list of bindings and a body.");
+  for(Value* binding = car(input); binding != EmptyList; binding = cdr(binding)){
+    checkArguments(car(binding), 2, 2, "Each let binding is a name and a value.");
+  }
+  compiler.compileLet(car(input), cdr(input), tail);
+}
+
+void Lambda(Compiler& compiler, Value* input, bool) {
+  checkArguments(input, 1, SIZE_MAX, "Lambda takes a list of parameters and a body.");
+  compiler.compileLambda(car(input), cdr(input));
+}
+
+// (quasiquote (1 (unquote (add 1 2)))) conses the list back together with
+// the unquoted forms evaluated. Only the parts of the template leading up
+// to a hole are consed at runtime: everything after the last hole in a
+// list, and any sublist without holes, is a constant shared with the
+// template.
+void Quasiquote(Compiler& compiler, Value* input, bool){
+  checkArguments(input, 1, 1, "Quasiquote takes exactly one argument.");
+  Template symbols{getInternedSymbol("quasiquote"), getInternedSymbol("unquote"),
+                   getInternedSymbol("unquote-splicing")};
+  compileTemplate(compiler, symbols, car(input), 0);
+}
+
+void Unquote(Compiler&, Value*, bool){
+  throw EvaluationError("Unquote can only happen inside quasiquote.");
+}
+
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "value.hpp"
+#include "eval.hpp"
+
+namespace crisp{
+
+/***** Classes *****/
+// Every instruction is a single word: the opcode in the low byte and an
+// operand (constant index, argument count or jump target) in the rest.
+enum class Opcode : uint8_t {
+  CONST,         // push constants[operand]
+  GLOBAL_REF,    // push the global binding of the symbol constants[operand], cached in cells[operand]
+  LOCAL_REF,     // push the local at the lexical address in operand
+  ENVT_REF,      // push the binding of constants[operand], searching the environment chain
+  GLOBAL_DEFINE, // pop a value and bind it globally to constants[operand]
+  ENVT_DEFINE,   // pop a value and bind it to constants[operand] in the current environment
+  GLOBAL_SET,    // pop a value and store it in the existing global binding, cached in cells[operand]
+  LOCAL_SET,     // pop a value and store it in the local at the lexical address in operand
+  ENVT_SET,      // pop a value and store it in the nearest existing binding
+  POP,           // discard the top of the stack
+  JUMP,          // continue at operand
+  JUMP_IF_FALSE, // pop a value and continue at operand if it's false
+  CLOSURE,       // push a procedure closing over the current environment for the code in constants[operand]
+  CALL,          // call the procedure below the top operand values
+  TAIL_CALL,     // same, but replace the current frame
+  RETURN,        // pop the current frame, leaving the top of the stack as its result
+  CONS,          // pop a cdr and a car, push the pair
+  APPEND,        // pop a tail and a list, push a copy of the list ending in the tail
+  FAR_REF,       // push the local at the lexical address in constants[operand]
+  FAR_SET,       // pop a value and store it in the local at the lexical address in constants[operand]
+};
+
+// one past the last opcode, the size of the VM's dispatch table
+constexpr uint32_t OpcodeCount = static_cast<uint32_t>(Opcode::FAR_SET) + 1;
+
+inline uint32_t encode(Opcode op, uint32_t operand = 0){
+  return static_cast<uint32_t>(op) | (operand << 8);
+}
+
+inline Opcode opcode(uint32_t instruction){
+  return static_cast<Opcode>(instruction & 0xff);
+}
+
+inline uint32_t operand(uint32_t instruction){
+  return instruction >> 8;
+}
+
+constexpr uint32_t MaxOperand = (1u << 24) - 1;
+
+// A lexical address picks a local by how many frames out it lives and its
+// slot in that frame, packed into one operand.
+constexpr uint32_t MaxDepth = (1u << 8) - 1;
+constexpr uint32_t MaxSlot = (1u << 16) - 1;
+
+inline uint32_t address(uint32_t depth, uint32_t slot){
+  return (depth << 16) | slot;
+}
+
+inline uint32_t depth(uint32_t address){
+  return address >> 16;
+}
+
+inline uint32_t slot(uint32_t address){
+  return address & MaxSlot;
+}
+
+// An address too deep or with too big a slot for an operand is kept whole
+// in a fixnum constant, for FAR_REF and FAR_SET.
+inline long farAddress(uint32_t depth, uint32_t slot){
+  return static_cast<long>((uint64_t{depth} << 32) | slot);
+}
+
+inline uint32_t farDepth(long address){
+  return static_cast<uint32_t>(static_cast<uint64_t>(address) >> 32);
+}
+
+inline uint32_t farSlot(long address){
+  return static_cast<uint32_t>(address);
+}
+
+// The compiled form of a top level expression or lambda body. Owned by a
+// CODE value, which is what closures point to.
+struct Code{
+  std::vector<uint32_t> instructions;
+  std::vector<Value*> constants;
+  Value* formals; // parameter list the arguments are bound to, EmptyList at top level
+  // names of the slots in a frame running this code: the parameters in
+  // order, then internal definitions and let bindings. Names from different
+  // scopes can repeat.
+  std::vector<Value*> locals;
+  // the global binding each GLOBAL_REF and GLOBAL_SET found, by the index of
+  // the symbol in constants, null until the instruction first runs
+  std::vector<Value**> cells;
+  // parameters before any rest parameter, and whether there is one, so
+  // calls can bind arguments without walking formals
+  uint32_t required = 0;
+  bool rest = false;
+};
+
+class Compiler{
+  public:
+    // envt is the environment the code will run in at top level; free
+    // variables are resolved globally when it's the global environment
+    Compiler(Compiler* enclosing, Value* formals, Environment* envt);
+
+    void compile(Value* form, bool tail);
+    // compile a sequence of forms, leaving the value of the last one
+    void compileBody(Value* body, bool tail);
+    void compileLambda(Value* formals, Value* body);
+    // (let ((name init)...) body...), bindings is the list of (name init)
+    void compileLet(Value* bindings, Value* body, bool tail);
+    void compileReference(Value* symbol);
+    void compileDefinition(Value* symbol);
+    void compileAssignment(Value* symbol);
+
+    void emit(Opcode op, uint32_t operand = 0);
+    size_t here() const;
+    void patch(size_t instruction, uint32_t target);
+    uint32_t constant(Value* value);
+    // wrap everything up in a CODE value
+    Value* finish();
+
+    Environment* environment() const { return envt_; }
+    bool isLocal(Value* symbol) const;
+    bool isGlobal() const;
+    // find the lexical address of a local, false if it's free
+    bool resolve(Value* symbol, uint32_t& depth, uint32_t& slot) const;
+
+  private:
+    void compileCall(Value* form, bool tail);
+    // the slot of symbol in the innermost body being compiled, made if it
+    // isn't declared there yet
+    uint32_t declare(Value* symbol);
+    // a fresh slot for symbol, visible until the scope it's in closes
+    uint32_t bind(Value* symbol);
+
+    Compiler* enclosing_;
+    Environment* envt_;
+    std::unique_ptr<Code> code_;
+    // the locals in scope and their slots, innermost last
+    std::vector<std::pair<Value*, uint32_t>> scope_;
+    // where the innermost body's (the procedure's or a let's) locals start
+    size_t body_start_;
+};
+
+/***** Functions *****/
+Value* compile(Value* input, Environment* envt);
+
+/***** Special Forms *****/
+void Quote(Compiler& compiler, Value* input, bool tail);
+void Define(Compiler& compiler, Value* input, bool tail);
+void Set(Compiler& compiler, Value* input, bool tail);
+void If(Compiler& compiler, Value* input, bool tail);
+void Let(Compiler& compiler, Value* input, bool tail);
+void Lambda(Compiler& compiler, Value* input, bool tail);
+void Quasiquote(Compiler& compiler, Value* input, bool tail);
+void Unquote(Compiler& compiler, Value* input, bool tail);
+
+}
@@ -1,301 +1,380 @@
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <new>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "value.hpp"
 #include "eval.hpp"
+#include "compile.hpp"
+#include "fasl.hpp"
+#include "image.hpp"
+#include "number.hpp"
 #include "read.hpp"
+#include "vm.hpp"
 
 using namespace std;
 
 namespace crisp{
-Environment GlobalEnvironment(nullptr);
+namespace { // unnamed namespace
 
-Value* Environment::getBinding(Value* value) {
-  auto bdg = bindings.find(value);
-  if(bdg != end(bindings)){
-    return bdg->second;
-  } else{
-    if(parent){
-      return parent->getBinding(value);
-    } else {
-      return nullptr;
-    }
+Value* integerArgument(Value* arg, const char* problem){
+  if(!isInteger(arg)){
+    throw EvaluationError(problem);
   }
+  return arg;
 }
 
-Value* Environment::getSymbolBinding(const std::string& key){
-  return getBinding(getInternedSymbol(key));
+// true if every argument is ordered against the next the way test wants
+// the comparison's sign to be
+template<typename Test>
+Value* compareArguments(Value** args, size_t argc, Test test){
+  bool res = true;
+  for(size_t i = 1; i < argc; ++i){
+    res = res && test(compareIntegers(integerArgument(args[i - 1], "Can only compare numbers."),
+                                      integerArgument(args[i], "Can only compare numbers.")));
+  }
+  return makeBoolean(res);
 }
 
-void Environment::setBinding(Value* key, Value* binding) {
-  bindings[key] = binding;
+// what initEval binds, by the names it binds them to
+struct SpecialFormEntry{
+  const char* name;
+  SpecialForm form;
+};
+
+const SpecialFormEntry SpecialForms[] = {
+  {"quote", Quote},
+  {"define", Define},
+  {"set!", Set},
+  {"if", If},
+  {"let", Let},
+  {"lambda", Lambda},
+  {"quasiquote", Quasiquote},
+  {"unquote", Unquote},
+  {"unquote-splicing", Unquote},
+};
+
+struct PrimitiveEntry{
+  const char* name;
+  PrimitiveProcedure procedure;
+  uint16_t arity;
+  bool variadic;
+};
+
+const PrimitiveEntry Primitives[] = {
+  {"addxy", addxyproc, 2, false},
+  {"read", read, 1, false},
+  {"cons", cons, 2, false},
+  {"add", add, 0, true},
+  {"add2ormore", add2ormore, 2, true},
+  {"sub", sub, 1, true},
+  {"mul", mul, 0, true},
+  {"<", lessThan, 2, true},
+  {"=", numberEquals, 2, true},
+  {"car", car, 1, false},
+  {"cdr", cdr, 1, false},
+  {"null?", isNull, 1, false},
+  {"eq?", isEq, 2, false},
+  {"load", load, 1, false},
+  {"fasl-write", faslWrite, 2, false},
+  {"fasl-read", faslRead, 1, false},
+  {"compile-file", compileFileProc, 2, false},
+  {"dump-image", dumpImageProc, 1, false},
+};
+
+} // end unnamed namespace
+
+Environment GlobalEnvironment(nullptr);
+
+void* Environment::operator new(size_t size) {
+  return gc::allocateEnvironment(size);
 }
 
-void Environment::setSymbolBinding(const std::string& key, Value* binding) {
-  setBinding(getInternedSymbol(key), binding);
+void Environment::operator delete(void* ptr) {
+  gc::freeEnvironment(ptr);
 }
 
-void initEval() {
-  /* Special Forms */
-  GlobalEnvironment.setSymbolBinding("quote", new Value(Quote));
-  GlobalEnvironment.setSymbolBinding("define", new Value(Define));
-  GlobalEnvironment.setSymbolBinding("set!", new Value(Set));
-  GlobalEnvironment.setSymbolBinding("if", new Value(If));
-  GlobalEnvironment.setSymbolBinding("let", new Value(Let));
-  GlobalEnvironment.setSymbolBinding("lambda", new Value(Lambda));
-  GlobalEnvironment.setSymbolBinding("quasiquote", new Value(Quasiquote));
-  GlobalEnvironment.setSymbolBinding("unquote", new Value(Unquote));
-
-  /* Primitive Procedures */
-  Value* args = new Value(getInternedSymbol("x"), new Value(getInternedSymbol("y"), EmptyList));
-  Value* addxy_proc = new Value(args, &GlobalEnvironment, addxyproc);
-  GlobalEnvironment.setSymbolBinding("addxy", addxy_proc);
-
-  args = new Value(getInternedSymbol("input"), EmptyList);
-  Value* read_proc = new Value(args, &GlobalEnvironment, read);
-  GlobalEnvironment.setSymbolBinding("read", read_proc);
-
-  args = new Value(getInternedSymbol("x"), new Value(getInternedSymbol("y"), EmptyList));
-  Value* cons_proc = new Value(args, &GlobalEnvironment, cons);
-  GlobalEnvironment.setSymbolBinding("cons", cons_proc);
-  
-  args = getInternedSymbol("args");
-  Value* add_proc = new Value(args, &GlobalEnvironment, add);
-  GlobalEnvironment.setSymbolBinding("add", add_proc);
-
-  args = new Value(
-      getInternedSymbol("first"),
-      new Value(getInternedSymbol("second"), getInternedSymbol("rest")));
-  Value* add2ormore_proc = new Value(args, &GlobalEnvironment, add2ormore);
-  GlobalEnvironment.setSymbolBinding("add2ormore", add2ormore_proc);
+Environment::Environment(Environment* e, Value* c, size_t n)
+    : bindings{}, code{c}, parent{e}, size{n}, epoch{gc::epoch()},
+      marked{false}, remembered{false} {
+  fill(slots(), slots() + size, nullptr);
 }
 
-Value* doEval(Value* input){
-  return eval(input, &GlobalEnvironment);
+Environment* Environment::frame(Environment* e, Value* c) {
+  size_t n = c->code->locals.size();
+  void* ptr = gc::allocateEnvironment(sizeof(Environment) + n * sizeof(Value*));
+  return ::new(ptr) Environment(e, c, n);
 }
 
-Value* eval(Value* input, Environment* envt) {
-  if(!input || input == EmptyList){
-    return input;
+Value** Environment::findBinding(Value* key) {
+  if(code){
+    // a let can reuse a name in the same frame, the later slot shadowing
+    // the earlier; compiled code never looks locals up by name anyway
+    auto& locals = code->code->locals;
+    auto local = find(locals.rbegin(), locals.rend(), key);
+    if(local != locals.rend()){
+      return &slots()[locals.rend() - local - 1];
+    }
   }
-  switch(input->type){
-    case Value::Type::FIXNUM:
-    case Value::Type::BOOLEAN:
-    case Value::Type::CHARACTER:
-    case Value::Type::STRING:{
-      return input;
-    } break;
-    case Value::Type::PAIR:{
-      if(input->car->type == Value::Type::SYMBOL){
-        auto binding = envt->getBinding(input->car);
-        if(!binding){
-          throw EvaluationError("Cannot call undefined symbol.");
-        }
-        if(binding->type == Value::Type::SPECIAL_FORM){
-          return binding->special_form(input->cdr, envt);
-        }
-        return eval(new Value(eval(input->car, envt), input->cdr), envt);
-      } else if(input->car->type == Value::Type::PAIR){
-        return eval(new Value(eval(input->car, envt), input->cdr), envt);
-      } else if(input->car->type == Value::Type::PROCEDURE){
-        Value* proc = input->car;
-        Value* args = input->cdr;
-
-        // First, evaluate all parameters
-        Value* eval_params = EmptyList;
-        for(Value* arg = args; arg != EmptyList; arg = arg->cdr){
-          eval_params = new Value(eval(arg->car, envt), eval_params);
-        }
-        Value* params = reverse(eval_params);
-
-        // Second, bind parameters to names. this may not be one to one (variadic)
-        Environment* new_envt = new Environment(proc->envt);
-        for(Value* param = params, *name = proc->args; name != EmptyList;
-             param = param->cdr, name = name->cdr) {
-          if(name->type != Value::Type::PAIR){
-            new_envt->setBinding(name, param);
-            break;
-          }
-          if(param == EmptyList){
-            throw EvaluationError("Missing required arguments.");
-          }
-          new_envt->setBinding(name->car, param->car);
-        }
-
-        if(proc->is_primitive){
-          return proc->prim_procedure(new_envt);
-        }
-        // eval sequence of the proc body, using the new envt
-        Value* res = nullptr;
-        for (Value* statement = proc->body; statement != EmptyList;
-             statement = statement->cdr) {
-          res = eval(statement->car, new_envt);
-        }
-        return res;
-      } else {
-        throw EvaluationError("Cannot evaluate a pair that doesn't start with a pair, symbol, or procedure.");
-      }
-    } break;
-    case Value::Type::SYMBOL:{
-      return evalSymbol(input, envt);
-    } break;
-    case Value::Type::SPECIAL_FORM:
-    case Value::Type::PROCEDURE:{
-      throw EvaluationError("Trying to evaluate a procedure that's not in a list.");
-    } break;
+  if(bindings){
+    auto bdg = bindings->find(key);
+    if(bdg != end(*bindings)){
+      return &bdg->second;
+    }
   }
+  return nullptr;
 }
 
-Value* evalSymbol(Value* symbol, Environment* envt) {
-  // should return the value this symbol was bound to
-  auto bdg = envt->getBinding(symbol);
-  if(!bdg){
-    throw EvaluationError("Cannot evaluate undefined symbol");
+Value* Environment::getBinding(Value* value) {
+  for(Environment* envt = this; envt; envt = envt->parent){
+    auto bdg = envt->findBinding(value);
+    if(bdg){
+      return *bdg;
+    }
   }
-  return bdg;
+  return nullptr;
 }
 
-/***** Special Forms *****/
-Value* Quote(Value* input, Environment*) {
-  return input->car;
-};
-
-Value* Define(Value* input, Environment* envt) {
-  envt->setBinding(input->car, eval(input->cdr->car, envt));
-  // MUST return null, since define has no printed result
-  return nullptr;
+Value* Environment::getSymbolBinding(const std::string& key){
+  return getBinding(getInternedSymbol(key));
 }
 
-Value* Set(Value* input, Environment* envt) {
-  auto bdg = envt->getBinding(input->car);
-  if(!bdg){
-    throw EvaluationError("Cannot set undefined symbol");
+void Environment::setBinding(Value* key, Value* binding) {
+  auto bdg = findBinding(key);
+  if(bdg){
+    *bdg = binding;
+  } else {
+    if(!bindings){
+      bindings.reset(new Bindings);
+    }
+    (*bindings)[key] = binding;
   }
-  // returns null, since set! has no printed result
-  return Define(input, envt);
+  gc::writeBarrier(this, binding);
 }
 
-Value* If(Value* input, Environment* envt) {
-  if(eval(input->car,envt) != &False){
-    return eval(input->cdr->car, envt);
-  } else {
-    return eval(input->cdr->cdr->car, envt);
+bool Environment::updateBinding(Value* key, Value* binding) {
+  for(Environment* envt = this; envt; envt = envt->parent){
+    auto bdg = envt->findBinding(key);
+    if(bdg){
+      *bdg = binding;
+      gc::writeBarrier(envt, binding);
+      return true;
+    }
   }
+  return false;
 }
 
-Value* Let(Value* input, Environment* envt) {
-  auto binding_forms = input->car;
-  auto body_forms = input->cdr;
+void Environment::setSymbolBinding(const std::string& key, Value* binding) {
+  setBinding(getInternedSymbol(key), binding);
+}
 
-  // make new envt
-  Environment* new_envt = new Environment(envt);
-  // walk through all binding forms and add bindings
-  for (Value* binding_form = binding_forms; binding_form != nullptr;
-       binding_form = binding_form->cdr) {
-    auto bound = eval(binding_form->car->cdr->car, envt);
-    new_envt->setBinding(binding_form->car->car, bound);
+void initEval() {
+  for(auto& form : SpecialForms){
+    GlobalEnvironment.setSymbolBinding(form.name, new Value(form.form));
   }
+  for(auto& primitive : Primitives){
+    GlobalEnvironment.setSymbolBinding(
+        primitive.name, new Value(primitive.procedure, primitive.arity, primitive.variadic));
+  }
+}
 
-  // walk through and evaluate all body forms with the new envt
-  Value* res = nullptr;
-  for (Value* body_form = body_forms; body_form != nullptr;
-       body_form = body_form->cdr) {
-    res = eval(body_form->car, new_envt);
+const char* builtinName(Value* value){
+  if(typeOf(value) == Value::Type::SPECIAL_FORM){
+    for(auto& form : SpecialForms){
+      if(form.form == value->special_form){
+        return form.name;
+      }
+    }
+  } else if(typeOf(value) == Value::Type::PROCEDURE && value->is_primitive){
+    for(auto& primitive : Primitives){
+      if(primitive.procedure == value->prim_procedure){
+        return primitive.name;
+      }
+    }
   }
-  return res;
+  return nullptr;
 }
 
-Value* Lambda(Value* input, Environment* envt) {
-  return new Value(input->car, envt, input->cdr);
+Value* makeBuiltin(const string& name){
+  for(auto& form : SpecialForms){
+    if(name == form.name){
+      return new Value(form.form);
+    }
+  }
+  for(auto& primitive : Primitives){
+    if(name == primitive.name){
+      return new Value(primitive.procedure, primitive.arity, primitive.variadic);
+    }
+  }
+  return nullptr;
 }
 
-Value* Quasiquote(Value* input, Environment* envt){
-  return doQuasiquote(input->car, envt);
+Value* doEval(Value* input){
+  return eval(input, &GlobalEnvironment);
 }
 
-// This form takes the list of values left to be quasiquoted
-// ((unquote (add 1 2)))
-Value* doQuasiquote(Value* input, Environment* envt){
-  if(input->type != Value::Type::PAIR || input == EmptyList){
-    return input;
-  }
-  auto first_subexpr = input->car; // (unquote (add 1 2))
-  auto rest_subexprs = input->cdr; // ()
-  if(first_subexpr->type == Value::Type::PAIR &&
-     first_subexpr->car == getInternedSymbol("unquote")){
-    // unquote, ie evaluate, the unquoted form
-    first_subexpr = eval(first_subexpr->cdr->car, envt);
-  }
-  // take resulting first_subexpr (which may have been evaluated)
-  // and continue quasiquoting rest_subexprs
-  return new Value(first_subexpr, doQuasiquote(rest_subexprs, envt));
+Value* eval(Value* input, Environment* envt) {
+  return execute(compile(input, envt), envt);
 }
 
-Value* Unquote(Value*, Environment*){
-  throw EvaluationError("Unquote can only happen inside quasiquote.");
+// The file is read straight out of its mapping, a form at a time, each
+// evaluated before the next is read. Compiled files (see compileFile) hold
+// code that's run as it is.
+Value* loadFile(const string& path){
+  MappedFile file{path};
+  Value* result = nullptr;
+  gc::Root result_root{result};
+  if(isFasl(file.data(), file.size())){
+    FaslReader reader{file.data(), file.size()};
+    while(Value* value = reader.next()){
+      result = typeOf(value) == Value::Type::CODE ? execute(value, &GlobalEnvironment)
+                                                : doEval(value);
+    }
+    return result;
+  }
+  Reader reader{file.data(), file.size()};
+  while(Value* form = reader.next()){
+    result = doEval(form);
+  }
+  return result;
 }
 
 /***** Primitive Procedures *****/
 // this dummy procedure adds the value of x with the value of y
-Value* addxyproc(Environment* envt){
-  auto x = envt->getSymbolBinding("x");
-  auto y = envt->getSymbolBinding("y");
-  if(!x || !y){
-    throw EvaluationError("Unable to get parameter for procedure.");
-  }
-  if(x->type != Value::Type::FIXNUM || y->type != Value::Type::FIXNUM){
-    throw EvaluationError("Unable to add two values that aren't fixnums.");
+Value* addxyproc(Value** args, size_t){
+  auto x = args[0];
+  auto y = args[1];
+  if(!isInteger(x) || !isInteger(y)){
+    throw EvaluationError("Unable to add two values that aren't integers.");
   }
+  return addIntegers(x, y);
+}
 
-  long res = x->fixnum + y->fixnum;
-  return new Value(res);
+Value* cons(Value** args, size_t){
+  return makePair(args[0], args[1]);
 }
 
-Value* cons(Environment* envt){
-  auto x = envt->getSymbolBinding("x");
-  auto y = envt->getSymbolBinding("y");
-  if(!x || !y){
-    throw EvaluationError("Unable to get parameter for procedure.");
+// Sums in a long until an argument is a bignum or the sum overflows, then
+// carries on in bignums from there.
+Value* add(Value** args, size_t argc){
+  long res = 0;
+  size_t i = 0;
+  for(; i < argc; ++i){
+    auto arg = integerArgument(args[i], "Can only add things that evaluate to numbers.");
+    long sum;
+    if(typeOf(arg) != Value::Type::FIXNUM || __builtin_add_overflow(res, fixnumValue(arg), &sum)){
+      break;
+    }
+    res = sum;
   }
-  return new Value(eval(x, envt), eval(y, envt));
+  if(i == argc){
+    return makeInteger(res);
+  }
+  Bignum total{res};
+  for(; i < argc; ++i){
+    total = total + toBignum(integerArgument(args[i], "Can only add things that evaluate to numbers."));
+  }
+  return makeInteger(move(total));
 }
 
-Value* add(Environment* envt){
-  auto args = envt->getSymbolBinding("args");
-  // args is a list of things to add
-  if(!args || args->type != Value::Type::PAIR){
-    throw EvaluationError("Must pass a list to add, even if its empty");
+Value* add2ormore(Value** args, size_t argc){
+  // the first two are required, which the arity check already made sure of
+  return add(args, argc);
+}
+
+// (sub x) negates, (sub x y z) is x - y - z
+Value* sub(Value** args, size_t argc){
+  auto first = integerArgument(args[0], "Can only subtract numbers.");
+  if(argc == 1){
+    return subtractIntegers(makeFixnum(0), first);
   }
   long res = 0;
-  for(Value* arg = args; arg != EmptyList; arg = arg->cdr){
-    if(arg->car->type != Value::Type::FIXNUM){
-      throw EvaluationError("Can only add things that evaluate to numbers.");
+  size_t i = 1;
+  if(typeOf(first) == Value::Type::FIXNUM){
+    res = fixnumValue(first);
+    for(; i < argc; ++i){
+      auto arg = integerArgument(args[i], "Can only subtract numbers.");
+      long difference;
+      if(typeOf(arg) != Value::Type::FIXNUM ||
+         __builtin_sub_overflow(res, fixnumValue(arg), &difference)){
+        break;
+      }
+      res = difference;
+    }
+    if(i == argc){
+      return makeInteger(res);
     }
-    res += arg->car->fixnum;
   }
-  return new Value{res};
+  Bignum total = i == 1 ? toBignum(first) : Bignum{res};
+  for(; i < argc; ++i){
+    total = total - toBignum(integerArgument(args[i], "Can only subtract numbers."));
+  }
+  return makeInteger(move(total));
 }
 
-Value* add2ormore(Environment* envt){
-  auto first = envt->getSymbolBinding("first");
-  auto second = envt->getSymbolBinding("second");
-  auto rest = envt->getSymbolBinding("rest");
-  if(!first || !second || !rest){
-    throw EvaluationError("Insufficient parameters, expects two or more.");
+Value* mul(Value** args, size_t argc){
+  long res = 1;
+  size_t i = 0;
+  for(; i < argc; ++i){
+    auto arg = integerArgument(args[i], "Can only multiply numbers.");
+    long product;
+    if(typeOf(arg) != Value::Type::FIXNUM ||
+       __builtin_mul_overflow(res, fixnumValue(arg), &product)){
+      break;
+    }
+    res = product;
   }
-  if(first->type != Value::Type::FIXNUM || second->type != Value::Type::FIXNUM){
-    throw EvaluationError("Can only add things that evaluate to numbers.");
+  if(i == argc){
+    return makeInteger(res);
   }
-  long res = first->fixnum + second->fixnum;
-  for(Value* arg = rest; arg != EmptyList; arg = arg->cdr){
-    if(arg->car->type != Value::Type::FIXNUM){
-      throw EvaluationError("Can only add things that evaluate to numbers.");
-    }
-    res += arg->car->fixnum;
+  Bignum total{res};
+  for(; i < argc; ++i){
+    total = total * toBignum(integerArgument(args[i], "Can only multiply numbers."));
   }
-  return new Value(res);
+  return makeInteger(move(total));
+}
+
+Value* lessThan(Value** args, size_t argc){
+  return compareArguments(args, argc, [](int order){ return order < 0; });
+}
+
+Value* numberEquals(Value** args, size_t argc){
+  return compareArguments(args, argc, [](int order){ return order == 0; });
+}
+
+Value* car(Value** args, size_t){
+  if(typeOf(args[0]) != Value::Type::PAIR || args[0] == EmptyList){
+    throw EvaluationError("Can only take the car of a pair.");
+  }
+  return car(args[0]);
+}
+
+Value* cdr(Value** args, size_t){
+  if(typeOf(args[0]) != Value::Type::PAIR || args[0] == EmptyList){
+    throw EvaluationError("Can only take the cdr of a pair.");
+  }
+  return cdr(args[0]);
+}
+
+Value* isNull(Value** args, size_t){
+  return makeBoolean(args[0] == EmptyList);
+}
+
+Value* load(Value** args, size_t){
+  if(typeOf(args[0]) != Value::Type::STRING){
+    throw EvaluationError("Can only load a file named by a string.");
+  }
+  // copied out, since evaluating the file can move the stack args is on
+  return loadFile(args[0]->str.str);
+}
+
+// symbols are interned and fixnums, characters and booleans are immediates,
+// so identity covers those too
+Value* isEq(Value** args, size_t){
+  return makeBoolean(args[0] == args[1]);
 }
 
 }
@@ -1,8 +1,11 @@
 #pragma once
+#include <memory>
+#include <string>
 #include <unordered_map>
 
 #include "value.hpp"
 #include "exception.hpp"
+#include "gc.hpp"
 
 namespace crisp{
 
@@ -14,36 +17,75 @@ class EvaluationError : public VerboseError {
 
 /***** Classes *****/
 struct Environment{
-  std::unordered_map<Value*, Value*> bindings;
+  using Bindings = std::unordered_map<Value*, Value*>;
+
+  // bindings made by name, only created for environments that get defined
+  // into (the global one, primitive calls, defines without a slot)
+  std::unique_ptr<Bindings> bindings;
+  // the CODE value naming the slots of a frame, null for other environments
+  Value* code;
   Environment* parent;
+  // number of slots, stored inline right after the environment
+  size_t size;
+  // used by the collector
+  size_t epoch;
+  bool marked;
+  bool remembered;
 
+  // locals of a compiled procedure, indexed by the slots the compiler gave
+  // them
+  Value** slots() { return reinterpret_cast<Value**>(this + 1); }
+  // where this environment (ignoring parents) keeps key, null if it doesn't.
+  // Named bindings are never removed, so once made one stays put and
+  // compiled code can hold on to it.
+  Value** findBinding(Value* key);
   Value* getBinding(Value* value);
   Value* getSymbolBinding(const std::string& key);
   void setBinding(Value* key, Value* binding);
+  // update the nearest existing binding, false if there isn't one
+  bool updateBinding(Value* key, Value* binding);
   void setSymbolBinding(const std::string& key, Value* binding);
-  Environment(Environment* e) : bindings{}, parent{e} {}
+  Environment(Environment* e)
+      : bindings{}, code{nullptr}, parent{e}, size{0}, epoch{gc::epoch()},
+        marked{false}, remembered{false} {}
+  // a frame for running the code in the CODE value c, allocated along with
+  // its slots in one block
+  static Environment* frame(Environment* e, Value* c);
+
+  // environments are owned by the collector, see gc.hpp
+  static void* operator new(size_t size);
+  static void operator delete(void* ptr);
+
+  private:
+    Environment(Environment* e, Value* c, size_t n);
 };
 
 /***** Function *****/
 void initEval();
+// the name initEval binds a primitive or special form to, null if it's
+// not one of those
+const char* builtinName(Value* value);
+// a new value for the primitive or special form initEval binds to name,
+// null if there isn't one
+Value* makeBuiltin(const std::string& name);
 Value* doEval(Value* input);
-Value* evalSymbol(Value* symbol, Environment* envt);
-
-/***** Special Forms *****/
-Value* Quote(Value* input, Environment*);
-Value* Define(Value* input, Environment* envt);
-Value* Set(Value* input, Environment* envt);
-Value* If(Value* input, Environment* envt);
-Value* Let(Value* input, Environment* envt);
-Value* Lambda(Value* input, Environment* envt);
-Value* doQuasiquote(Value* input, Environment* envt);
-Value* Quasiquote(Value* input, Environment* envt);
-Value* Unquote(Value* input, Environment* envt);
+// evaluates every form in the file in turn, returning the last one's value
+Value* loadFile(const std::string& path);
+
 /***** Primitive Procedures *****/
-Value* addxyproc(Environment* envt);
-Value* cons(Environment* envt);
-Value* add(Environment* envt);
-Value* add2ormore(Environment* envt);
+Value* addxyproc(Value** args, size_t argc);
+Value* cons(Value** args, size_t argc);
+Value* add(Value** args, size_t argc);
+Value* add2ormore(Value** args, size_t argc);
+Value* sub(Value** args, size_t argc);
+Value* mul(Value** args, size_t argc);
+Value* lessThan(Value** args, size_t argc);
+Value* numberEquals(Value** args, size_t argc);
+Value* car(Value** args, size_t argc);
+Value* cdr(Value** args, size_t argc);
+Value* isNull(Value** args, size_t argc);
+Value* isEq(Value** args, size_t argc);
+Value* load(Value** args, size_t argc);
 
 Value* eval(Value* input, Environment* envt);
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstring>
 #include <exception>
 
 namespace crisp{
@@ -9,7 +10,7 @@ class VerboseError : public std::exception {
       return message_;
     }
     VerboseError(const char* prefix, const char* problem) {
-      message_ = new char[strlen(prefix) + strlen(problem)]();
+      message_ = new char[strlen(prefix) + strlen(problem) + 1]();
       strcpy(message_, prefix);
       strcat(message_, problem);
     }
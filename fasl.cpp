@@ -0,0 +1,758 @@
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <unordered_set>
+
+#include "fasl.hpp"
+#include "compile.hpp"
+#include "eval.hpp"
+#include "number.hpp"
+#include "read.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+const char Magic[] = "CRISPFASL";
+constexpr size_t MagicLength = sizeof(Magic) - 1;
+constexpr uint8_t Version = 3;
+
+enum Tag : uint8_t {
+  FIXNUM,
+  TRUE,
+  FALSE,
+  CHARACTER,
+  STRING,
+  EMPTY_LIST,
+  PAIR,
+  SYMBOL,     // a new symbol's name
+  SYMBOL_REF, // a symbol that's already appeared
+  LABEL,      // the value that follows is referred to again
+  REF,        // a labelled value
+  CODE,
+  NONE,       // an unspecified value, like an unassigned slot
+  PROCEDURE,  // a compiled procedure: its environment, formals and code
+  BUILTIN,    // a primitive or special form, by the name initEval gives it
+  ENV_GLOBAL,
+  ENV_REF,    // an environment that's already been written
+  ENV,        // its parent, code and slots, then its named bindings
+  BIGNUM      // twice the limb count plus the sign, then the limbs
+};
+
+// the values that are written once and referred to after that
+bool shareable(Value* value){
+  return value != EmptyList && (typeOf(value) == Value::Type::PAIR ||
+                                typeOf(value) == Value::Type::STRING ||
+                                typeOf(value) == Value::Type::BIGNUM ||
+                                typeOf(value) == Value::Type::CODE ||
+                                typeOf(value) == Value::Type::PROCEDURE);
+}
+
+string pathArgument(Value* arg){
+  if(typeOf(arg) != Value::Type::STRING){
+    throw EvaluationError("File names must be strings.");
+  }
+  return arg->str.str;
+}
+
+/***** Checking Code *****/
+// The VM trusts the code it runs, so code read from a file is checked
+// before anything can run it. frames holds the number of slots in each
+// frame the code can address, innermost first.
+constexpr size_t Unreached = SIZE_MAX;
+
+// Follows every path through the instructions, keeping track of how many
+// values are on the stack, which has to come out the same wherever paths
+// meet. So no instruction pops more than its frame pushed and none runs
+// off the end. The code each CLOSURE makes goes on closures.
+void checkInstructions(Code* code, const vector<size_t>& frames, vector<Code*>& closures){
+  auto& instructions = code->instructions;
+  vector<size_t> heights(instructions.size(), Unreached);
+  vector<size_t> pending;
+  auto reach = [&](size_t target, size_t height){
+    if(target >= instructions.size()){
+      throw FaslError("Bad instruction.");
+    }
+    if(heights[target] == Unreached){
+      heights[target] = height;
+      pending.push_back(target);
+    } else if(heights[target] != height){
+      throw FaslError("Bad instruction.");
+    }
+  };
+  auto constant = [&](uint32_t index){
+    if(index >= code->constants.size()){
+      throw FaslError("Bad instruction.");
+    }
+    return code->constants[index];
+  };
+  auto local = [&](uint32_t depth, uint32_t slot){
+    if(depth >= frames.size() || slot >= frames[depth]){
+      throw FaslError("Bad instruction.");
+    }
+  };
+  auto far = [&](uint32_t index){
+    Value* address = constant(index);
+    if(!isFixnum(address) || fixnumValue(address) < 0){
+      throw FaslError("Bad instruction.");
+    }
+    local(farDepth(fixnumValue(address)), farSlot(fixnumValue(address)));
+  };
+
+  reach(0, 0);
+  while(!pending.empty()){
+    size_t index = pending.back();
+    pending.pop_back();
+    uint32_t instruction = instructions[index];
+    uint32_t arg = operand(instruction);
+    size_t height = heights[index];
+    size_t pops = 0;
+    size_t pushes = 0;
+    switch(opcode(instruction)){
+      case Opcode::CONST:
+      case Opcode::GLOBAL_REF:
+      case Opcode::ENVT_REF:
+        constant(arg);
+        pushes = 1;
+        break;
+      case Opcode::LOCAL_REF:
+        local(depth(arg), slot(arg));
+        pushes = 1;
+        break;
+      case Opcode::FAR_REF:
+        far(arg);
+        pushes = 1;
+        break;
+      case Opcode::GLOBAL_DEFINE:
+      case Opcode::ENVT_DEFINE:
+      case Opcode::GLOBAL_SET:
+      case Opcode::ENVT_SET:
+        constant(arg);
+        pops = pushes = 1;
+        break;
+      case Opcode::LOCAL_SET:
+        local(depth(arg), slot(arg));
+        pops = pushes = 1;
+        break;
+      case Opcode::FAR_SET:
+        far(arg);
+        pops = pushes = 1;
+        break;
+      case Opcode::POP:
+      case Opcode::JUMP_IF_FALSE:
+        pops = 1;
+        break;
+      case Opcode::JUMP:
+        break;
+      case Opcode::CLOSURE:{
+        Value* target = constant(arg);
+        if(!target || typeOf(target) != Value::Type::CODE){
+          throw FaslError("Bad instruction.");
+        }
+        closures.push_back(target->code);
+        pushes = 1;
+      } break;
+      case Opcode::CALL:
+      case Opcode::TAIL_CALL:
+        // the procedure and its arguments
+        pops = size_t{arg} + 1;
+        pushes = 1;
+        break;
+      case Opcode::RETURN:
+        pops = 1;
+        break;
+      case Opcode::CONS:
+      case Opcode::APPEND:
+        pops = 2;
+        pushes = 1;
+        break;
+      default:
+        throw FaslError("Bad instruction.");
+    }
+    if(height < pops){
+      throw FaslError("Bad instruction.");
+    }
+    height = height - pops + pushes;
+    if(opcode(instruction) == Opcode::JUMP || opcode(instruction) == Opcode::JUMP_IF_FALSE){
+      reach(arg, height);
+    }
+    if(opcode(instruction) != Opcode::JUMP && opcode(instruction) != Opcode::RETURN){
+      reach(index + 1, height);
+    }
+  }
+}
+
+// the slots in each frame from envt out, short of the global environment
+vector<size_t> frameSizes(Environment* envt){
+  vector<size_t> frames;
+  for(; envt && envt != &GlobalEnvironment; envt = envt->parent){
+    frames.push_back(envt->size);
+  }
+  return frames;
+}
+
+// Checks all the code in a value, each against the frames it will run in:
+// a procedure's are its own and its environment's, an environment's code
+// runs in that environment, a closure's are its own and those of the code
+// that makes it, and other code, the value itself included, runs at top
+// level, with none. Code that turns up in more than one place has to run
+// in the same frames in each.
+void checkCode(Value* value, const vector<Value*>& code, const vector<Value*>& procedures,
+               const vector<Environment*>& environments){
+  unordered_map<Code*, vector<size_t>> contexts;
+  vector<Code*> pending;
+  auto enter = [&](Code* c, vector<size_t> frames){
+    auto known = contexts.find(c);
+    if(known != end(contexts)){
+      if(known->second != frames){
+        throw FaslError("Bad instruction.");
+      }
+      return;
+    }
+    contexts.emplace(c, move(frames));
+    pending.push_back(c);
+  };
+  auto check = [&]{
+    vector<Code*> closures;
+    while(!pending.empty()){
+      Code* c = pending.back();
+      pending.pop_back();
+      // references to elements survive rehashing
+      const vector<size_t>& frames = contexts[c];
+      closures.clear();
+      checkInstructions(c, frames, closures);
+      for(Code* closure : closures){
+        vector<size_t> inner{closure->locals.size()};
+        inner.insert(end(inner), begin(frames), end(frames));
+        enter(closure, move(inner));
+      }
+    }
+  };
+
+  // loadFile runs a code value at top level, whatever else it's part of
+  if(value && typeOf(value) == Value::Type::CODE){
+    enter(value->code, {});
+    check();
+  }
+  for(Value* procedure : procedures){
+    if(!procedure->body || typeOf(procedure->body) != Value::Type::CODE){
+      throw FaslError("Expected code for a procedure.");
+    }
+    vector<size_t> frames = frameSizes(procedure->envt);
+    frames.insert(begin(frames), procedure->body->code->locals.size());
+    enter(procedure->body->code, move(frames));
+    check();
+  }
+  for(Environment* envt : environments){
+    if(envt->code){
+      enter(envt->code->code, frameSizes(envt));
+      check();
+    }
+  }
+  // in the order it was read, so code is reached from what makes it
+  // before being taken for top level code
+  for(Value* c : code){
+    if(!contexts.count(c->code)){
+      enter(c->code, {});
+      check();
+    }
+  }
+}
+
+} // end unnamed namespace
+
+/***** Writer *****/
+FaslWriter::FaslWriter(ostream& output) : output_(output) {
+  output_.write(Magic, MagicLength);
+  writeTag(Version);
+}
+
+void FaslWriter::writeTag(uint8_t tag){
+  output_.put(static_cast<char>(tag));
+}
+
+void FaslWriter::writeVarint(uint64_t n){
+  while(n >= 0x80){
+    output_.put(static_cast<char>(n | 0x80));
+    n >>= 7;
+  }
+  output_.put(static_cast<char>(n));
+}
+
+// Counts how many times each shareable value is reached from value, not
+// descending into anything a second time. Environments are looked through,
+// so values a closure's environment shares with anything else stay shared.
+void FaslWriter::countReferences(Value* value){
+  references_.clear();
+  unordered_set<Environment*> environments;
+  vector<Value*> pending{value};
+  while(!pending.empty()){
+    Value* v = pending.back();
+    pending.pop_back();
+    if(!v || !shareable(v) || references_[v]++){
+      continue;
+    }
+    if(typeOf(v) == Value::Type::PAIR){
+      pending.push_back(cdr(v));
+      pending.push_back(car(v));
+    } else if(typeOf(v) == Value::Type::CODE){
+      Code* code = v->code;
+      pending.push_back(code->formals);
+      pending.insert(end(pending), begin(code->constants), end(code->constants));
+    } else if(typeOf(v) == Value::Type::PROCEDURE && !v->is_primitive){
+      pending.push_back(v->args);
+      pending.push_back(v->body);
+      for(Environment* envt = v->envt;
+          envt && envt != &GlobalEnvironment && environments.insert(envt).second;
+          envt = envt->parent){
+        pending.push_back(envt->code);
+        pending.insert(end(pending), envt->slots(), envt->slots() + envt->size);
+        if(envt->bindings){
+          for(auto& binding : *envt->bindings){
+            pending.push_back(binding.second);
+          }
+        }
+      }
+    }
+  }
+}
+
+void FaslWriter::write(Value* value){
+  if(!value){
+    throw FaslError("Cannot write an unspecified value.");
+  }
+  // nothing keeps what was written before alive, so its address could
+  // belong to something else by now
+  labels_.clear();
+  environments_.clear();
+  countReferences(value);
+  writeValue(value);
+  if(!output_){
+    throw FaslError("Unable to write file.");
+  }
+}
+
+// Written from an explicit stack, children pushed last first, so neither
+// long lists nor deep nesting recurse.
+void FaslWriter::writeValue(Value* value){
+  vector<Value*> pending{value};
+  while(!pending.empty()){
+    Value* v = pending.back();
+    pending.pop_back();
+    if(!v){
+      writeTag(NONE);
+      continue;
+    }
+    auto label = labels_.find(v);
+    if(label != end(labels_)){
+      writeTag(REF);
+      writeVarint(label->second);
+      continue;
+    }
+    if(shareable(v) && references_[v] > 1){
+      size_t index = labels_.size();
+      labels_[v] = index;
+      writeTag(LABEL);
+    }
+    if(v == EmptyList){
+      writeTag(EMPTY_LIST);
+      continue;
+    }
+    switch(typeOf(v)){
+      case Value::Type::FIXNUM:{
+        writeTag(FIXNUM);
+        // zigzag, so small negative numbers stay short too
+        uint64_t n = static_cast<uint64_t>(fixnumValue(v));
+        writeVarint((n << 1) ^ (fixnumValue(v) < 0 ? ~uint64_t{0} : 0));
+      } break;
+      case Value::Type::BIGNUM:{
+        auto& limbs = v->bignum->limbs();
+        writeTag(BIGNUM);
+        writeVarint(limbs.size() * 2 + v->bignum->negative());
+        for(auto limb : limbs){
+          writeVarint(limb);
+        }
+      } break;
+      case Value::Type::BOOLEAN:{
+        writeTag(v == True ? TRUE : FALSE);
+      } break;
+      case Value::Type::CHARACTER:{
+        writeTag(CHARACTER);
+        output_.put(characterValue(v));
+      } break;
+      case Value::Type::STRING:{
+        size_t length = strlen(v->str.str);
+        writeTag(STRING);
+        writeVarint(length);
+        output_.write(v->str.str, length);
+      } break;
+      case Value::Type::SYMBOL:{
+        auto symbol = symbols_.find(v);
+        if(symbol != end(symbols_)){
+          writeTag(SYMBOL_REF);
+          writeVarint(symbol->second);
+        } else {
+          size_t index = symbols_.size();
+          symbols_[v] = index;
+          writeTag(SYMBOL);
+          writeVarint(v->symbol.length);
+          output_.write(v->symbol.name, v->symbol.length);
+        }
+      } break;
+      case Value::Type::PAIR:{
+        writeTag(PAIR);
+        pending.push_back(cdr(v));
+        pending.push_back(car(v));
+      } break;
+      case Value::Type::CODE:{
+        Code* code = v->code;
+        writeTag(CODE);
+        writeVarint(code->instructions.size());
+        for(uint32_t instruction : code->instructions){
+          writeVarint(instruction);
+        }
+        writeVarint(code->locals.size());
+        writeVarint(code->constants.size());
+        writeVarint(code->required);
+        writeVarint(code->rest);
+        pending.insert(end(pending), code->constants.rbegin(), code->constants.rend());
+        pending.insert(end(pending), code->locals.rbegin(), code->locals.rend());
+        pending.push_back(code->formals);
+      } break;
+      case Value::Type::PROCEDURE:{
+        if(v->is_primitive){
+          writeBuiltin(v);
+          break;
+        }
+        writeTag(PROCEDURE);
+        writeEnvironment(v->envt, pending);
+        pending.push_back(v->body);
+        pending.push_back(v->args);
+      } break;
+      case Value::Type::SPECIAL_FORM:{
+        writeBuiltin(v);
+      } break;
+    }
+  }
+}
+
+void FaslWriter::writeBuiltin(Value* value){
+  const char* name = builtinName(value);
+  if(!name){
+    throw FaslError("Cannot write a primitive that isn't built in.");
+  }
+  size_t length = strlen(name);
+  writeTag(BUILTIN);
+  writeVarint(length);
+  output_.write(name, length);
+}
+
+// Writes what's needed to create the environment and its parents where
+// it's first used, leaving the values in its slots and bindings on pending
+// to be written with everything else. Those values can include closures
+// over this environment, which by then it's safe to refer to.
+void FaslWriter::writeEnvironment(Environment* envt, vector<Value*>& pending){
+  if(envt == &GlobalEnvironment){
+    writeTag(ENV_GLOBAL);
+    return;
+  }
+  auto known = environments_.find(envt);
+  if(known != end(environments_)){
+    writeTag(ENV_REF);
+    writeVarint(known->second);
+    return;
+  }
+  if(!envt){
+    throw FaslError("Cannot write a procedure without an environment.");
+  }
+  writeTag(ENV);
+  writeEnvironment(envt->parent, pending);
+  // code holds no environments, so this doesn't recurse any further
+  writeValue(envt->code);
+  size_t index = environments_.size();
+  environments_[envt] = index;
+  writeVarint(envt->bindings ? envt->bindings->size() : 0);
+  if(envt->bindings){
+    for(auto& binding : *envt->bindings){
+      writeValue(binding.first);
+    }
+  }
+  pending.insert(end(pending), envt->slots(), envt->slots() + envt->size);
+  if(envt->bindings){
+    for(auto& binding : *envt->bindings){
+      pending.push_back(binding.second);
+    }
+  }
+}
+
+/***** Reader *****/
+bool isFasl(const char* data, size_t size){
+  return size > MagicLength && memcmp(data, Magic, MagicLength) == 0;
+}
+
+FaslReader::FaslReader(const char* data, size_t size) : pos_{data}, end_{data + size} {
+  if(!isFasl(data, size)){
+    throw FaslError("Not a FASL file.");
+  }
+  pos_ += MagicLength;
+  if(readByte() != Version){
+    throw FaslError("Unsupported FASL version.");
+  }
+}
+
+uint8_t FaslReader::readByte(){
+  if(pos_ == end_){
+    throw FaslError("Truncated file.");
+  }
+  return static_cast<uint8_t>(*pos_++);
+}
+
+uint64_t FaslReader::readVarint(){
+  uint64_t n = 0;
+  for(int shift = 0; shift < 64; shift += 7){
+    uint8_t byte = readByte();
+    n |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if(!(byte & 0x80)){
+      return n;
+    }
+  }
+  throw FaslError("Varint too long.");
+}
+
+const char* FaslReader::readBytes(size_t count){
+  if(static_cast<size_t>(end_ - pos_) < count){
+    throw FaslError("Truncated file.");
+  }
+  const char* bytes = pos_;
+  pos_ += count;
+  return bytes;
+}
+
+Value* FaslReader::next(){
+  if(pos_ == end_){
+    return nullptr;
+  }
+  // the collector doesn't see what earlier values were read into, which
+  // may have run and been collected since
+  labels_.clear();
+  environments_.clear();
+  code_.clear();
+  procedures_.clear();
+  Value* value = readValue();
+  checkCode(value, code_, procedures_, environments_);
+  return value;
+}
+
+// Mirrors the writer: an explicit stack of the places still waiting for a
+// value, filled in the order the values were written. Pairs, code and
+// procedures are created before their contents, so labels can be referred
+// to from inside the value they label.
+Value* FaslReader::readValue(){
+  Value* result = nullptr;
+  vector<Value**> holes{&result};
+  while(!holes.empty()){
+    Value** hole = holes.back();
+    holes.pop_back();
+    uint8_t tag = readByte();
+    bool labelled = tag == LABEL;
+    size_t label = labels_.size();
+    if(labelled){
+      labels_.push_back(nullptr);
+      tag = readByte();
+    }
+    Value* value = nullptr;
+    switch(tag){
+      case FIXNUM:{
+        uint64_t n = readVarint();
+        long fixnum = static_cast<long>((n >> 1) ^ (~(n & 1) + 1));
+        if(fixnum < FixnumMin || fixnum > FixnumMax){
+          throw FaslError("Fixnum out of range.");
+        }
+        value = makeFixnum(fixnum);
+      } break;
+      case BIGNUM:{
+        uint64_t header = readVarint();
+        // every limb takes at least a byte
+        if(header / 2 > static_cast<size_t>(end_ - pos_)){
+          throw FaslError("Truncated file.");
+        }
+        vector<Bignum::Limb> limbs(header / 2);
+        for(auto& limb : limbs){
+          limb = static_cast<Bignum::Limb>(readVarint());
+        }
+        value = makeInteger(Bignum{move(limbs), (header & 1) != 0});
+      } break;
+      case TRUE: value = True; break;
+      case FALSE: value = False; break;
+      case CHARACTER: value = makeCharacter(static_cast<char>(readByte())); break;
+      case STRING:{
+        size_t length = readVarint();
+        Value::Str s{readBytes(length), length};
+        value = new Value(s);
+      } break;
+      case EMPTY_LIST: value = EmptyList; break;
+      case PAIR:{
+        value = makePair(EmptyList, EmptyList);
+        holes.push_back(&cdr(value));
+        holes.push_back(&car(value));
+      } break;
+      case SYMBOL:{
+        size_t length = readVarint();
+        value = getInternedSymbol(readBytes(length), length);
+        symbols_.push_back(value);
+      } break;
+      case SYMBOL_REF:{
+        size_t index = readVarint();
+        if(index >= symbols_.size()){
+          throw FaslError("Bad symbol reference.");
+        }
+        value = symbols_[index];
+      } break;
+      case REF:{
+        size_t index = readVarint();
+        if(index >= labels_.size() || !labels_[index]){
+          throw FaslError("Bad reference.");
+        }
+        value = labels_[index];
+      } break;
+      case CODE:{
+        unique_ptr<Code> code{new Code{{}, {}, EmptyList, {}, {}}};
+        code->instructions.resize(readVarint());
+        for(auto& instruction : code->instructions){
+          instruction = static_cast<uint32_t>(readVarint());
+        }
+        code->locals.resize(readVarint());
+        code->constants.resize(readVarint());
+        code->cells.resize(code->constants.size());
+        code->required = static_cast<uint32_t>(readVarint());
+        code->rest = readVarint() != 0;
+        if(code->required + code->rest > code->locals.size()){
+          throw FaslError("Bad parameter count.");
+        }
+        // the vectors are their final size, so pointers into them hold
+        for(size_t i = code->constants.size(); i > 0; --i){
+          holes.push_back(&code->constants[i - 1]);
+        }
+        for(size_t i = code->locals.size(); i > 0; --i){
+          holes.push_back(&code->locals[i - 1]);
+        }
+        holes.push_back(&code->formals);
+        value = new Value(code.release());
+        code_.push_back(value);
+      } break;
+      case NONE: value = nullptr; break;
+      case PROCEDURE:{
+        Environment* envt = readEnvironment(holes);
+        value = new Value(EmptyList, envt, nullptr);
+        procedures_.push_back(value);
+        holes.push_back(&value->body);
+        holes.push_back(&value->args);
+      } break;
+      case BUILTIN:{
+        size_t length = readVarint();
+        value = makeBuiltin(string(readBytes(length), length));
+        if(!value){
+          throw FaslError("Unknown primitive.");
+        }
+      } break;
+      default:
+        throw FaslError("Unknown tag.");
+    }
+    if(labelled){
+      labels_[label] = value;
+    }
+    *hole = value;
+  }
+  return result;
+}
+
+Environment* FaslReader::readEnvironment(vector<Value**>& holes){
+  uint8_t tag = readByte();
+  if(tag == ENV_GLOBAL){
+    return &GlobalEnvironment;
+  }
+  if(tag == ENV_REF){
+    size_t index = readVarint();
+    if(index >= environments_.size()){
+      throw FaslError("Bad environment reference.");
+    }
+    return environments_[index];
+  }
+  if(tag != ENV){
+    throw FaslError("Expected an environment.");
+  }
+  Environment* parent = readEnvironment(holes);
+  Value* code = readValue();
+  if(code && typeOf(code) != Value::Type::CODE){
+    throw FaslError("Expected code for an environment.");
+  }
+  // it's young, so filling it in needs no write barrier
+  Environment* envt = code ? Environment::frame(parent, code) : new Environment(parent);
+  environments_.push_back(envt);
+  vector<Value**> bindings;
+  for(size_t count = readVarint(); count > 0; --count){
+    if(!envt->bindings){
+      envt->bindings.reset(new Environment::Bindings);
+    }
+    // the map's nodes don't move as it grows
+    bindings.push_back(&(*envt->bindings)[readValue()]);
+  }
+  for(size_t i = 0; i < envt->size; ++i){
+    holes.push_back(&envt->slots()[i]);
+  }
+  holes.insert(end(holes), begin(bindings), end(bindings));
+  return envt;
+}
+
+/***** Functions *****/
+void faslWriteFile(const string& path, Value* value){
+  ofstream output{path, ios::binary};
+  if(!output){
+    throw FaslError("Unable to open file.");
+  }
+  FaslWriter writer{output};
+  writer.write(value);
+}
+
+Value* faslReadFile(const string& path){
+  MappedFile file{path};
+  FaslReader reader{file.data(), file.size()};
+  return reader.next();
+}
+
+// Forms are only compiled, not run, so special forms are the ones bound
+// when this is called.
+void compileFile(const string& source, const string& destination){
+  MappedFile file{source};
+  Reader reader{file.data(), file.size()};
+  ofstream output{destination, ios::binary};
+  if(!output){
+    throw FaslError("Unable to open file.");
+  }
+  FaslWriter writer{output};
+  while(Value* form = reader.next()){
+    writer.write(compile(form, &GlobalEnvironment));
+  }
+}
+
+/***** Primitive Procedures *****/
+// (fasl-write "file" value)
+Value* faslWrite(Value** args, size_t){
+  faslWriteFile(pathArgument(args[0]), args[1]);
+  return nullptr;
+}
+
+// (fasl-read "file")
+Value* faslRead(Value** args, size_t){
+  Value* value = faslReadFile(pathArgument(args[0]));
+  return value ? value : EmptyList;
+}
+
+// (compile-file "source" "destination")
+Value* compileFileProc(Value** args, size_t){
+  compileFile(pathArgument(args[0]), pathArgument(args[1]));
+  return nullptr;
+}
+
+}
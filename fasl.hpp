@@ -0,0 +1,107 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "value.hpp"
+#include "exception.hpp"
+#include "eval.hpp"
+
+namespace crisp{
+
+/***** Exceptions *****/
+class FaslError : public VerboseError {
+  public:
+    FaslError(const char* problem) : VerboseError("FASL error: ", problem) {}
+};
+
+/***** Classes *****/
+// A FASL file is a header followed by any number of values, each written
+// depth first, car before cdr:
+//
+//   fixnums    zigzag varints
+//   bignums    the sign and limb count, then the limbs, least significant
+//              first
+//   symbols    the name the first time one appears in the file, its index
+//              among the file's symbols after that
+//   strings    a varint length and the bytes
+//   code       the instructions, then its formals, locals and constants
+//   procedures their environment, formals and code; primitives and special
+//              forms by the name initEval binds them to
+//
+// Environments are numbered as they're written and referred to by number
+// after that, the global environment by a tag of its own.
+//
+// A pair, string or code object that's reachable more than once from the
+// same value is labelled where it's first written and referred to by label
+// after that, so shared (and circular) structure comes back shared.
+//
+// Labels and environment numbers start over with each value, since loading
+// runs each value before the next is read, so nothing keeps the earlier
+// ones alive. Symbols are never collected, so their numbers last the file.
+class FaslWriter{
+  public:
+    // writes the header
+    explicit FaslWriter(std::ostream& output);
+    void write(Value* value);
+
+  private:
+    void countReferences(Value* value);
+    void writeValue(Value* value);
+    void writeBuiltin(Value* value);
+    void writeEnvironment(Environment* envt, std::vector<Value*>& pending);
+    void writeTag(uint8_t tag);
+    void writeVarint(uint64_t n);
+
+    std::ostream& output_;
+    std::unordered_map<Value*, size_t> symbols_;
+    std::unordered_map<Value*, size_t> labels_;
+    std::unordered_map<Environment*, size_t> environments_;
+    std::unordered_map<Value*, size_t> references_; // for the value being written
+};
+
+// Reads values back out of a FASL file that's in memory, usually a
+// MappedFile. Nothing it reads points back into the data. Code is checked
+// before it's handed out, so a damaged file can't crash the VM.
+class FaslReader{
+  public:
+    // checks the header
+    FaslReader(const char* data, size_t size);
+    // the next value, or null once the data is exhausted
+    Value* next();
+
+  private:
+    Value* readValue();
+    Environment* readEnvironment(std::vector<Value**>& holes);
+    uint8_t readByte();
+    uint64_t readVarint();
+    const char* readBytes(size_t count);
+
+    const char* pos_;
+    const char* end_;
+    std::vector<Value*> symbols_;
+    std::vector<Value*> labels_;
+    std::vector<Environment*> environments_;
+    // what's been read of the current value that holds code, checked once
+    // it's all there
+    std::vector<Value*> code_;
+    std::vector<Value*> procedures_;
+};
+
+/***** Functions *****/
+// whether data starts with a FASL header
+bool isFasl(const char* data, size_t size);
+void faslWriteFile(const std::string& path, Value* value);
+// the first value in the file
+Value* faslReadFile(const std::string& path);
+// compiles every form in a source file and writes the code to a FASL
+// file, which load runs without reading or compiling anything
+void compileFile(const std::string& source, const std::string& destination);
+
+/***** Primitive Procedures *****/
+Value* faslWrite(Value** args, size_t argc);
+Value* faslRead(Value** args, size_t argc);
+Value* compileFileProc(Value** args, size_t argc);
+
+}
@@ -0,0 +1,778 @@
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <unordered_set>
+#include <vector>
+
+#include "gc.hpp"
+#include "value.hpp"
+#include "number.hpp"
+#include "eval.hpp"
+#include "compile.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace gc{
+namespace detail{
+
+char* nursery_start = nullptr;
+char* nursery_top = nullptr;
+char* nursery_pairs = nullptr;
+char* nursery_pair_top = nullptr;
+char* nursery_end = nullptr;
+size_t epoch = 0;
+
+}
+namespace { // unnamed namespace
+
+// Values with a header all have one size and pairs another, so the old space
+// is made of fixed-size cells carved out of large aligned chunks, each chunk
+// holding just the one kind. Every chunk keeps an allocation bitmap and a mark
+// bitmap in its header, which keeps the collector's bookkeeping out of Value.
+constexpr size_t ChunkBytes = 1 << 18;
+constexpr size_t HeaderBytes = 4096;
+constexpr size_t ValueBytes = sizeof(Value);
+constexpr size_t PairBytes = sizeof(Pair);
+// pairs are the smaller, so their chunks have the most cells
+constexpr size_t MaxCellsPerChunk = (ChunkBytes - HeaderBytes) / PairBytes;
+constexpr size_t BitmapWords = (MaxCellsPerChunk + 63) / 64;
+constexpr size_t DefaultThreshold = 1 << 22;
+
+// New values and pairs are bump allocated in the nursery. Most of them are
+// dead by the time it fills up, so a nursery collection copies the survivors
+// into the old space and resets the bump pointers.
+constexpr size_t NurseryValueBytes = 1 << 20;
+constexpr size_t NurseryPairBytes = 1 << 20;
+constexpr size_t NurseryBytes = NurseryValueBytes + NurseryPairBytes;
+// the forwarding bitmap has a bit for every pair sized piece of the nursery
+constexpr size_t Granule = PairBytes;
+constexpr size_t NurseryGranules = NurseryBytes / Granule;
+// collect at a safepoint once less than this is left of either part, so we
+// rarely overflow
+constexpr size_t NurseryValueSlack = NurseryValueBytes / 8;
+constexpr size_t NurseryPairSlack = NurseryPairBytes / 8;
+// Environments live outside the nursery, but die just as young: a tail
+// recursive loop can allocate a frame per iteration without allocating a
+// single value, so they also count towards starting a nursery collection.
+constexpr size_t YoungEnvironmentBytes = NurseryValueBytes;
+
+struct Chunk{
+  size_t cell_bytes;
+  uint64_t allocated[BitmapWords];
+  uint64_t marked[BitmapWords];
+
+  char* cells() { return reinterpret_cast<char*>(this) + HeaderBytes; }
+  size_t cellCount() const { return (ChunkBytes - HeaderBytes) / cell_bytes; }
+  size_t index(void* cell) {
+    return (static_cast<char*>(cell) - cells()) / cell_bytes;
+  }
+};
+static_assert(sizeof(Chunk) <= HeaderBytes, "chunk header doesn't fit");
+
+struct FreeCell{
+  FreeCell* next;
+};
+
+// a nursery cell that has been copied out holds the address of its copy
+struct ForwardedCell{
+  Value* forward;
+};
+
+// the chunks holding one size of cell
+struct Space{
+  explicit Space(size_t bytes) : cell_bytes{bytes}, chunks{}, free_list{nullptr} {}
+  size_t cell_bytes;
+  vector<Chunk*> chunks;
+  FreeCell* free_list;
+};
+
+struct Heap{
+  Space values{ValueBytes};
+  Space pairs{PairBytes};
+  unordered_set<Chunk*> chunk_set;
+  vector<uint64_t> forwarded; // one bit per nursery granule
+  vector<Environment*> environments; // promoted environments
+  vector<Environment*> young_environments; // created since the last nursery collection
+  vector<Value**> roots;
+  vector<Environment**> environment_roots;
+  vector<vector<Value*>*> root_vectors;
+  vector<vector<Environment*>*> environment_root_vectors;
+  // old objects that may point into the nursery
+  vector<Environment*> remembered_environments;
+  vector<Value*> remembered_values; // allocated in the old space while the nursery was full
+  vector<Value*> young_finalizable; // need finalizing if they die young
+  size_t promoted_since_collection = 0;
+  // nursery bytes used before the last reset
+  size_t nursery_value_bytes_retired = 0;
+  size_t nursery_pair_bytes_retired = 0;
+  // allocated directly in the old space
+  size_t tenured_bytes = 0;
+  size_t tenured_objects = 0;
+  size_t environment_bytes = 0;
+  size_t young_environment_bytes = 0; // allocated since the last nursery collection
+  bool collecting = false;
+  Statistics stats{0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, DefaultThreshold};
+
+  // tracing state, only used during a collection
+  vector<Value*> gray_values;
+  vector<Environment*> gray_environments;
+  vector<Environment*> marked_environments;
+  unordered_set<Value*> marked_foreign; // values not allocated by us (statics, locals)
+};
+
+Heap& heap(){
+  static Heap h;
+  return h;
+}
+
+Chunk* chunkOf(void* ptr){
+  Heap& h = heap();
+  auto chunk = reinterpret_cast<Chunk*>(
+      reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t)(ChunkBytes - 1));
+  if(h.chunk_set.count(chunk) == 0 ||
+     static_cast<char*>(ptr) < chunk->cells()){
+    return nullptr;
+  }
+  return chunk;
+}
+
+void addChunk(Space& space){
+  Heap& h = heap();
+  void* mem = aligned_alloc(ChunkBytes, ChunkBytes);
+  if(!mem){
+    throw bad_alloc();
+  }
+  auto chunk = new(mem) Chunk;
+  chunk->cell_bytes = space.cell_bytes;
+  for(size_t w = 0; w < BitmapWords; ++w){
+    chunk->allocated[w] = 0;
+    chunk->marked[w] = 0;
+  }
+  space.chunks.push_back(chunk);
+  h.chunk_set.insert(chunk);
+  // thread the fresh cells onto the free list, lowest address first
+  for(size_t i = chunk->cellCount(); i-- > 0;){
+    auto cell = reinterpret_cast<FreeCell*>(chunk->cells() + i * space.cell_bytes);
+    cell->next = space.free_list;
+    space.free_list = cell;
+  }
+  h.stats.heap_size += ChunkBytes;
+}
+
+void* allocateOld(Space& space){
+  if(!space.free_list){
+    addChunk(space);
+  }
+  FreeCell* cell = space.free_list;
+  space.free_list = cell->next;
+  Chunk* chunk = chunkOf(cell);
+  size_t idx = chunk->index(cell);
+  assert(!(chunk->allocated[idx / 64] & (uint64_t{1} << (idx % 64))));
+  chunk->allocated[idx / 64] |= uint64_t{1} << (idx % 64);
+  return cell;
+}
+
+void addNursery(){
+  Heap& h = heap();
+  // operator new only promises alignment for the biggest scalar
+  void* mem = aligned_alloc(Granule, NurseryBytes);
+  if(!mem){
+    throw bad_alloc();
+  }
+  detail::nursery_start = static_cast<char*>(mem);
+  detail::nursery_top = detail::nursery_start;
+  detail::nursery_pairs = detail::nursery_start + NurseryValueBytes;
+  detail::nursery_pair_top = detail::nursery_pairs;
+  detail::nursery_end = detail::nursery_start + NurseryBytes;
+  h.forwarded.assign((NurseryGranules + 63) / 64, 0);
+  h.stats.nursery_size = NurseryBytes;
+}
+
+void finalize(Value* value){
+  switch(value->type){
+    case Value::Type::STRING:{
+      delete[] value->str.str;
+    } break;
+    case Value::Type::CODE:{
+      delete value->code;
+    } break;
+    case Value::Type::BIGNUM:{
+      delete value->bignum;
+    } break;
+    default:
+      break;
+  }
+}
+
+bool isYoungEnvironment(Environment* envt){
+  return envt->epoch == detail::epoch;
+}
+
+// what a word that points into the heap points to
+char* cellOf(Value* value){
+  return reinterpret_cast<char*>(wordOf(value) & AddressMask);
+}
+
+bool isPairCell(Value* value){
+  return (wordOf(value) & TagMask) == PairTag;
+}
+
+/***** Nursery collection *****/
+size_t nurseryIndex(char* cell){
+  return (cell - detail::nursery_start) / Granule;
+}
+
+bool isForwarded(char* cell){
+  size_t idx = nurseryIndex(cell);
+  return heap().forwarded[idx / 64] & (uint64_t{1} << (idx % 64));
+}
+
+void forward(Value*& slot){
+  Value* value = slot;
+  if(!isYoung(value)){
+    return;
+  }
+  Heap& h = heap();
+  char* cell = cellOf(value);
+  if(isForwarded(cell)){
+    slot = reinterpret_cast<ForwardedCell*>(cell)->forward;
+    return;
+  }
+  bool pair = isPairCell(value);
+  size_t bytes = pair ? PairBytes : ValueBytes;
+  void* copy_cell = allocateOld(pair ? h.pairs : h.values);
+  memcpy(copy_cell, cell, bytes);
+  // the copy keeps the original's tag
+  Value* copy = valueOf(reinterpret_cast<uintptr_t>(copy_cell) | (wordOf(value) & ~AddressMask));
+  size_t idx = nurseryIndex(cell);
+  h.forwarded[idx / 64] |= uint64_t{1} << (idx % 64);
+  reinterpret_cast<ForwardedCell*>(cell)->forward = copy;
+  h.gray_values.push_back(copy);
+  h.promoted_since_collection += bytes;
+  h.stats.bytes_promoted += bytes;
+  slot = copy;
+}
+
+// Young environments don't move: they're traced when reachable and deleted
+// otherwise. Old ones are only looked at when remembered.
+void visitEnvironment(Environment* envt){
+  if(!envt || envt->marked || !isYoungEnvironment(envt)){
+    return;
+  }
+  Heap& h = heap();
+  envt->marked = true;
+  h.gray_environments.push_back(envt);
+  h.marked_environments.push_back(envt);
+}
+
+void scanValue(Value* value){
+  switch(typeOf(value)){
+    case Value::Type::PAIR:{
+      forward(car(value));
+      forward(cdr(value));
+    } break;
+    case Value::Type::PROCEDURE:{
+      forward(value->args);
+      visitEnvironment(value->envt);
+      if(!value->is_primitive){
+        forward(value->body);
+      }
+    } break;
+    case Value::Type::CODE:{
+      for(auto& constant : value->code->constants){
+        forward(constant);
+      }
+      forward(value->code->formals);
+    } break;
+    case Value::Type::FIXNUM:
+    case Value::Type::BOOLEAN:
+    case Value::Type::CHARACTER:
+    case Value::Type::STRING:
+    case Value::Type::SYMBOL:
+    case Value::Type::SPECIAL_FORM:
+    case Value::Type::BIGNUM:
+      break;
+  }
+}
+
+void scanEnvironment(Environment* envt){
+  if(envt->bindings){
+    for(auto& binding : *envt->bindings){
+      // keys are symbols, which are always tenured
+      forward(binding.second);
+    }
+  }
+  for(size_t i = 0; i < envt->size; ++i){
+    forward(envt->slots()[i]);
+  }
+  forward(envt->code);
+  visitEnvironment(envt->parent);
+}
+
+void evacuateNursery(){
+  Heap& h = heap();
+  for(auto slot : h.roots){
+    forward(*slot);
+  }
+  for(auto slot : h.environment_roots){
+    visitEnvironment(*slot);
+  }
+  for(auto values : h.root_vectors){
+    for(auto& slot : *values){
+      forward(slot);
+    }
+  }
+  for(auto envts : h.environment_root_vectors){
+    for(auto envt : *envts){
+      visitEnvironment(envt);
+    }
+  }
+  visitEnvironment(&GlobalEnvironment);
+  for(auto envt : h.remembered_environments){
+    envt->remembered = false;
+    scanEnvironment(envt);
+  }
+  h.remembered_environments.clear();
+  for(auto value : h.remembered_values){
+    scanValue(value);
+  }
+  h.remembered_values.clear();
+  while(!h.gray_values.empty() || !h.gray_environments.empty()){
+    while(!h.gray_values.empty()){
+      Value* value = h.gray_values.back();
+      h.gray_values.pop_back();
+      scanValue(value);
+    }
+    if(!h.gray_environments.empty()){
+      Environment* envt = h.gray_environments.back();
+      h.gray_environments.pop_back();
+      scanEnvironment(envt);
+    }
+  }
+
+  // everything left behind is garbage
+  for(auto value : h.young_finalizable){
+    if(!isForwarded(cellOf(value))){
+      finalize(value);
+    }
+  }
+  h.young_finalizable.clear();
+  for(auto envt : h.young_environments){
+    if(envt->marked){
+      h.environments.push_back(envt);
+      h.promoted_since_collection += sizeof(Environment) + envt->size * sizeof(Value*);
+    } else {
+      delete envt;
+      ++h.stats.environments_freed;
+    }
+  }
+  h.young_environments.clear();
+  h.young_environment_bytes = 0;
+  for(auto envt : h.marked_environments){
+    envt->marked = false;
+  }
+  h.marked_environments.clear();
+
+  size_t values_used = detail::nursery_top - detail::nursery_start;
+  size_t pairs_used = detail::nursery_pair_top - detail::nursery_pairs;
+  h.nursery_value_bytes_retired += values_used;
+  h.nursery_pair_bytes_retired += pairs_used;
+  // the pairs start on a word of the bitmap of their own
+  auto pair_bits = begin(h.forwarded) + NurseryValueBytes / Granule / 64;
+  fill(begin(h.forwarded), begin(h.forwarded) + (values_used / Granule + 63) / 64, 0);
+  fill(pair_bits, pair_bits + (pairs_used / Granule + 63) / 64, 0);
+  detail::nursery_top = detail::nursery_start;
+  detail::nursery_pair_top = detail::nursery_pairs;
+  ++detail::epoch;
+  ++h.stats.minor_collections;
+}
+
+/***** Marking *****/
+void markValue(Value* value){
+  // immediates have nothing to trace
+  if(!value || (wordOf(value) & HeapTagMask)){
+    return;
+  }
+  Heap& h = heap();
+  Chunk* chunk = chunkOf(cellOf(value));
+  if(!chunk){
+    if(h.marked_foreign.insert(value).second){
+      h.gray_values.push_back(value);
+    }
+    return;
+  }
+  size_t idx = chunk->index(cellOf(value));
+  uint64_t bit = uint64_t{1} << (idx % 64);
+  if(chunk->marked[idx / 64] & bit){
+    return;
+  }
+  chunk->marked[idx / 64] |= bit;
+  h.gray_values.push_back(value);
+}
+
+void markEnvironment(Environment* envt){
+  if(!envt || envt->marked){
+    return;
+  }
+  Heap& h = heap();
+  envt->marked = true;
+  h.gray_environments.push_back(envt);
+  h.marked_environments.push_back(envt);
+}
+
+void traceValue(Value* value){
+  switch(typeOf(value)){
+    case Value::Type::PAIR:{
+      markValue(car(value));
+      markValue(cdr(value));
+    } break;
+    case Value::Type::PROCEDURE:{
+      markValue(value->args);
+      markEnvironment(value->envt);
+      if(!value->is_primitive){
+        markValue(value->body);
+      }
+    } break;
+    case Value::Type::CODE:{
+      for(auto constant : value->code->constants){
+        markValue(constant);
+      }
+      markValue(value->code->formals);
+    } break;
+    case Value::Type::FIXNUM:
+    case Value::Type::BOOLEAN:
+    case Value::Type::CHARACTER:
+    case Value::Type::STRING:
+    case Value::Type::SYMBOL:
+    case Value::Type::SPECIAL_FORM:
+    case Value::Type::BIGNUM:
+      break;
+  }
+}
+
+void traceEnvironment(Environment* envt){
+  if(envt->bindings){
+    for(auto& binding : *envt->bindings){
+      markValue(binding.first);
+      markValue(binding.second);
+    }
+  }
+  for(size_t i = 0; i < envt->size; ++i){
+    markValue(envt->slots()[i]);
+  }
+  markValue(envt->code);
+  markEnvironment(envt->parent);
+}
+
+// only called right after the nursery has been emptied, so everything
+// reachable is either in the old space or not ours
+void markRoots(){
+  Heap& h = heap();
+  for(auto symbol : internedSymbols()){
+    markValue(symbol);
+  }
+  markEnvironment(&GlobalEnvironment);
+  for(auto slot : h.roots){
+    markValue(*slot);
+  }
+  for(auto slot : h.environment_roots){
+    markEnvironment(*slot);
+  }
+  for(auto values : h.root_vectors){
+    for(auto value : *values){
+      markValue(value);
+    }
+  }
+  for(auto envts : h.environment_root_vectors){
+    for(auto envt : *envts){
+      markEnvironment(envt);
+    }
+  }
+  // use an explicit worklist so long lists don't recurse on the C++ stack
+  while(!h.gray_values.empty() || !h.gray_environments.empty()){
+    while(!h.gray_values.empty()){
+      Value* value = h.gray_values.back();
+      h.gray_values.pop_back();
+      traceValue(value);
+    }
+    if(!h.gray_environments.empty()){
+      Environment* envt = h.gray_environments.back();
+      h.gray_environments.pop_back();
+      traceEnvironment(envt);
+    }
+  }
+}
+
+/***** Sweeping *****/
+// returns the number of cells still in use
+size_t sweepSpace(Space& space){
+  Heap& h = heap();
+  vector<Chunk*> kept;
+  size_t released = 0;
+  space.free_list = nullptr;
+  size_t live = 0;
+  for(auto chunk : space.chunks){
+    size_t chunk_live = 0;
+    for(size_t w = 0; w < BitmapWords; ++w){
+      uint64_t dead = chunk->allocated[w] & ~chunk->marked[w];
+      h.stats.objects_freed += __builtin_popcountll(dead);
+      // pairs own nothing
+      for(; dead && &space == &h.values; dead &= dead - 1){
+        size_t bit = __builtin_ctzll(dead);
+        finalize(reinterpret_cast<Value*>(chunk->cells() + (w * 64 + bit) * space.cell_bytes));
+      }
+      chunk->allocated[w] &= chunk->marked[w];
+      chunk->marked[w] = 0;
+      chunk_live += __builtin_popcountll(chunk->allocated[w]);
+    }
+    if(chunk_live == 0 && space.chunks.size() - released > 1){
+      // hand completely empty chunks back, but always hold on to one
+      ++released;
+      h.chunk_set.erase(chunk);
+      h.stats.heap_size -= ChunkBytes;
+      free(chunk);
+      continue;
+    }
+    live += chunk_live;
+    kept.push_back(chunk);
+  }
+  space.chunks.swap(kept);
+  // rebuild the free list from the surviving chunks, lowest address first
+  for(auto itr = space.chunks.rbegin(); itr != space.chunks.rend(); ++itr){
+    Chunk* chunk = *itr;
+    for(size_t i = chunk->cellCount(); i-- > 0;){
+      if(chunk->allocated[i / 64] & (uint64_t{1} << (i % 64))){
+        continue;
+      }
+      auto cell = reinterpret_cast<FreeCell*>(chunk->cells() + i * space.cell_bytes);
+      cell->next = space.free_list;
+      space.free_list = cell;
+    }
+  }
+  return live;
+}
+
+void sweepValues(){
+  Heap& h = heap();
+  h.stats.live_objects = sweepSpace(h.values) + sweepSpace(h.pairs);
+}
+
+void sweepEnvironments(){
+  Heap& h = heap();
+  size_t kept = 0;
+  for(auto envt : h.environments){
+    if(envt->marked){
+      h.environments[kept++] = envt;
+    } else {
+      delete envt;
+      ++h.stats.environments_freed;
+    }
+  }
+  h.environments.resize(kept);
+  for(auto envt : h.marked_environments){
+    envt->marked = false;
+  }
+  h.marked_environments.clear();
+  h.stats.live_environments = kept;
+}
+
+} // end unnamed namespace
+
+namespace detail{
+
+void* allocateValueSlow(size_t size){
+  assert(size == ValueBytes && "values are the only thing living in value cells");
+  Heap& h = heap();
+  if(!nursery_start){
+    addNursery();
+    return allocateValue(size);
+  }
+  // The nursery is full and we're not at a safepoint, so this one goes
+  // straight into the old space. It may end up pointing into the nursery, so
+  // it's remembered until the next nursery collection.
+  Value* value = static_cast<Value*>(allocateOld(h.values));
+  h.remembered_values.push_back(value);
+  h.promoted_since_collection += size;
+  h.tenured_bytes += size;
+  ++h.tenured_objects;
+  return value;
+}
+
+// the same for pairs, remembered as pairs, which is what the caller is
+// about to make of the cell
+void* allocatePairSlow(size_t size){
+  assert(size == PairBytes && "pairs are the only thing living in pair cells");
+  Heap& h = heap();
+  if(!nursery_start){
+    addNursery();
+    return allocatePair(size);
+  }
+  void* cell = allocateOld(h.pairs);
+  h.remembered_values.push_back(valueOf(reinterpret_cast<uintptr_t>(cell) | PairTag));
+  h.promoted_since_collection += size;
+  h.tenured_bytes += size;
+  ++h.tenured_objects;
+  return cell;
+}
+
+void rememberEnvironment(Environment* envt){
+  if(isYoungEnvironment(envt) || envt->remembered){
+    return;
+  }
+  envt->remembered = true;
+  heap().remembered_environments.push_back(envt);
+}
+
+}
+
+Root::Root(Value*& slot){
+  heap().roots.push_back(&slot);
+}
+
+Root::~Root(){
+  heap().roots.pop_back();
+}
+
+EnvironmentRoot::EnvironmentRoot(Environment*& slot){
+  heap().environment_roots.push_back(&slot);
+}
+
+EnvironmentRoot::~EnvironmentRoot(){
+  heap().environment_roots.pop_back();
+}
+
+void* allocateTenuredValue(size_t size){
+  assert(size == ValueBytes && "values are the only thing living in value cells");
+  Heap& h = heap();
+  h.promoted_since_collection += size;
+  h.tenured_bytes += size;
+  ++h.tenured_objects;
+  return allocateOld(h.values);
+}
+
+RootVector::RootVector(vector<Value*>& values) : values_{values} {
+  heap().root_vectors.push_back(&values_);
+}
+
+RootVector::~RootVector(){
+  auto& vectors = heap().root_vectors;
+  vectors.erase(find(begin(vectors), end(vectors), &values_));
+}
+
+EnvironmentRootVector::EnvironmentRootVector(vector<Environment*>& envts)
+    : envts_{envts} {
+  heap().environment_root_vectors.push_back(&envts_);
+}
+
+EnvironmentRootVector::~EnvironmentRootVector(){
+  auto& vectors = heap().environment_root_vectors;
+  vectors.erase(find(begin(vectors), end(vectors), &envts_));
+}
+
+void registerFinalizer(Value* value){
+  if(isYoung(value)){
+    heap().young_finalizable.push_back(value);
+  }
+}
+
+void freeValue(void* ptr){
+  if(isYoung(static_cast<Value*>(ptr))){
+    // the nursery is reclaimed wholesale
+    return;
+  }
+  Heap& h = heap();
+  Chunk* chunk = chunkOf(ptr);
+  assert(chunk && "freeing a value that wasn't allocated by the collector");
+  size_t idx = chunk->index(ptr);
+  chunk->allocated[idx / 64] &= ~(uint64_t{1} << (idx % 64));
+  auto cell = static_cast<FreeCell*>(ptr);
+  cell->next = h.values.free_list;
+  h.values.free_list = cell;
+}
+
+void* allocateEnvironment(size_t size){
+  Heap& h = heap();
+  void* envt = ::operator new(size);
+  h.young_environments.push_back(static_cast<Environment*>(envt));
+  h.environment_bytes += size;
+  h.young_environment_bytes += size;
+  return envt;
+}
+
+void freeEnvironment(void* envt){
+  Heap& h = heap();
+  if(!h.collecting){
+    // only happens when a constructor throws, so it's always one of the newest
+    for(auto itr = h.young_environments.rbegin(); itr != h.young_environments.rend(); ++itr){
+      if(*itr == envt){
+        h.young_environments.erase(next(itr).base());
+        break;
+      }
+    }
+  }
+  ::operator delete(envt);
+}
+
+void safepoint(){
+  Heap& h = heap();
+  if(static_cast<size_t>(detail::nursery_pairs - detail::nursery_top) < NurseryValueSlack ||
+     static_cast<size_t>(detail::nursery_end - detail::nursery_pair_top) < NurseryPairSlack ||
+     h.young_environment_bytes >= YoungEnvironmentBytes ||
+     !h.remembered_values.empty()){
+    collectNursery();
+  }
+  if(h.promoted_since_collection >= h.stats.threshold){
+    collect();
+  }
+}
+
+void collectNursery(){
+  Heap& h = heap();
+  if(h.collecting || !detail::nursery_start){
+    return;
+  }
+  h.collecting = true;
+  evacuateNursery();
+  h.collecting = false;
+}
+
+void collect(){
+  Heap& h = heap();
+  if(h.collecting){
+    return;
+  }
+  h.collecting = true;
+  if(detail::nursery_start){
+    evacuateNursery();
+  }
+  markRoots();
+  sweepValues();
+  sweepEnvironments();
+  h.marked_foreign.clear();
+  h.promoted_since_collection = 0;
+  ++h.stats.collections;
+  h.collecting = false;
+}
+
+void setThreshold(size_t bytes){
+  heap().stats.threshold = bytes;
+}
+
+const Statistics& statistics(){
+  Heap& h = heap();
+  size_t value_bytes = h.nursery_value_bytes_retired +
+                       (detail::nursery_top - detail::nursery_start);
+  size_t pair_bytes = h.nursery_pair_bytes_retired +
+                      (detail::nursery_pair_top - detail::nursery_pairs);
+  h.stats.objects_allocated = value_bytes / ValueBytes + pair_bytes / PairBytes +
+                              h.tenured_objects;
+  h.stats.bytes_allocated = value_bytes + pair_bytes + h.tenured_bytes + h.environment_bytes;
+  return h.stats;
+}
+
+}
+}
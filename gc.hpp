@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace crisp{
+
+struct Environment;
+class Value;
+
+namespace gc{
+
+/***** Statistics *****/
+struct Statistics{
+  size_t collections;        // number of completed full collections
+  size_t minor_collections;  // number of completed nursery collections
+  size_t objects_allocated;  // values allocated since startup
+  size_t bytes_allocated;    // bytes handed out since startup
+  size_t bytes_promoted;     // bytes copied out of the nursery into the old space
+  size_t objects_freed;      // old space values reclaimed since startup
+  size_t environments_freed; // environments reclaimed since startup
+  size_t live_objects;       // old space values still in use after the last collection
+  size_t live_environments;  // environments still in use after the last collection
+  size_t heap_size;          // bytes currently reserved for the old space
+  size_t nursery_size;       // bytes reserved for the nursery
+  size_t threshold;          // bytes promoted into the old space between full collections
+};
+
+/***** Roots *****/
+// Registers a local Value* as a root for as long as it's in scope. Anything
+// that holds on to a value across a call that might reach a safepoint (ie
+// anything that calls eval) has to root it, since the collector moves young
+// values and updates the rooted slot. Never call eval from inside the
+// arguments of `new Value(...)`: the cell is allocated before the arguments
+// are evaluated, and a collection in between will reclaim it.
+class Root{
+  public:
+    explicit Root(Value*& slot);
+    ~Root();
+    Root(const Root&) = delete;
+    Root& operator=(const Root&) = delete;
+};
+
+class EnvironmentRoot{
+  public:
+    explicit EnvironmentRoot(Environment*& slot);
+    ~EnvironmentRoot();
+    EnvironmentRoot(const EnvironmentRoot&) = delete;
+    EnvironmentRoot& operator=(const EnvironmentRoot&) = delete;
+};
+
+// Registers a whole vector as roots, for things like the VM's stack that
+// grow and shrink too quickly to root one slot at a time.
+class RootVector{
+  public:
+    explicit RootVector(std::vector<Value*>& values);
+    ~RootVector();
+    RootVector(const RootVector&) = delete;
+    RootVector& operator=(const RootVector&) = delete;
+  private:
+    std::vector<Value*>& values_;
+};
+
+class EnvironmentRootVector{
+  public:
+    explicit EnvironmentRootVector(std::vector<Environment*>& envts);
+    ~EnvironmentRootVector();
+    EnvironmentRootVector(const EnvironmentRootVector&) = delete;
+    EnvironmentRootVector& operator=(const EnvironmentRootVector&) = delete;
+  private:
+    std::vector<Environment*>& envts_;
+};
+
+// Tag for values that must never move, ie symbols, which are used as keys
+// by address: `new(gc::tenured) Value(...)`
+struct Tenured{};
+constexpr Tenured tenured{};
+
+namespace detail{
+// the nursery: values from start up to pairs, then pairs up to end, each
+// with its own bump pointer
+extern char* nursery_start;
+extern char* nursery_top;
+extern char* nursery_pairs;
+extern char* nursery_pair_top;
+extern char* nursery_end;
+extern size_t epoch;
+void* allocateValueSlow(size_t size);
+void* allocatePairSlow(size_t size);
+void rememberEnvironment(Environment* envt);
+}
+
+// A Value* that points into the heap has these bits clear, anything else
+// (fixnums, characters and so on, see value.hpp) is an immediate. The
+// other tag bit marks a pair.
+constexpr uintptr_t HeapTagMask = 5;
+constexpr uintptr_t AddressMask = ~uintptr_t{7};
+
+/***** Functions *****/
+// New values are bump allocated in the nursery; the slow path takes care of
+// setting it up, and of overflowing into the old space between safepoints.
+inline void* allocateValue(size_t size){
+  char* cell = detail::nursery_top;
+  if(static_cast<size_t>(detail::nursery_pairs - cell) >= size){
+    detail::nursery_top = cell + size;
+    return cell;
+  }
+  return detail::allocateValueSlow(size);
+}
+
+// pairs have no header, so they get a part of the nursery of their own
+inline void* allocatePair(size_t size){
+  char* cell = detail::nursery_pair_top;
+  if(static_cast<size_t>(detail::nursery_end - cell) >= size){
+    detail::nursery_pair_top = cell + size;
+    return cell;
+  }
+  return detail::allocatePairSlow(size);
+}
+
+inline bool isYoung(const Value* value){
+  auto word = reinterpret_cast<uintptr_t>(value);
+  auto ptr = reinterpret_cast<const char*>(word & AddressMask);
+  return !(word & HeapTagMask) && ptr >= detail::nursery_start && ptr < detail::nursery_end;
+}
+
+// number of nursery collections so far; anything created before the current
+// epoch has been promoted
+inline size_t epoch(){
+  return detail::epoch;
+}
+
+// has to be called whenever a value is stored into an existing environment
+inline void writeBarrier(Environment* envt, Value* value){
+  if(isYoung(value)){
+    detail::rememberEnvironment(envt);
+  }
+}
+
+void* allocateTenuredValue(size_t size);
+// strings and code own memory that has to be freed if they die in the nursery
+void registerFinalizer(Value* value);
+void freeValue(void* cell);
+void* allocateEnvironment(size_t size);
+void freeEnvironment(void* envt);
+
+// collects if the nursery is nearly full or enough has been promoted since
+// the last full collection
+void safepoint();
+void collectNursery();
+void collect();
+
+void setThreshold(size_t bytes);
+const Statistics& statistics();
+
+}
+}
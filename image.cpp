@@ -0,0 +1,89 @@
+#include <fstream>
+
+#include "image.hpp"
+#include "eval.hpp"
+#include "fasl.hpp"
+#include "read.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+const char ImageTag[] = "crisp-image";
+
+} // end unnamed namespace
+
+// An image is a FASL file holding two values: (crisp-image symbol ...),
+// every interned symbol in the order it was interned, then an association
+// list of the global bindings. Nothing in it is an address, so booting
+// relocates the heap wherever the new process allocates it: pointers come
+// back through the reader's symbol, label and environment tables.
+void dumpImage(const string& path){
+  ofstream output{path, ios::binary};
+  if(!output){
+    throw FaslError("Unable to open file.");
+  }
+  FaslWriter writer{output};
+  Value* tag = getInternedSymbol(ImageTag);
+  auto& symbols = internedSymbols();
+  Value* symbol_list = EmptyList;
+  for(auto symbol = symbols.rbegin(); symbol != symbols.rend(); ++symbol){
+    symbol_list = makePair(*symbol, symbol_list);
+  }
+  writer.write(makePair(tag, symbol_list));
+
+  Value* bindings = EmptyList;
+  if(GlobalEnvironment.bindings){
+    for(auto& binding : *GlobalEnvironment.bindings){
+      // primitives bound by the embedding program have nothing to be
+      // written as, and have to be bound again after booting
+      Value* value = binding.second;
+      if(value && typeOf(value) == Value::Type::PROCEDURE && value->is_primitive &&
+         !builtinName(value)){
+        continue;
+      }
+      bindings = makePair(makePair(binding.first, value), bindings);
+    }
+  }
+  writer.write(bindings);
+}
+
+void bootImage(const string& path){
+  MappedFile file{path};
+  FaslReader reader{file.data(), file.size()};
+  Value* header = reader.next();
+  if(!header || typeOf(header) != Value::Type::PAIR || header == EmptyList ||
+     car(header) != getInternedSymbol(ImageTag)){
+    throw FaslError("Not a heap image.");
+  }
+  // all checked before any are bound, so a bad image changes nothing
+  Value* bindings = reader.next();
+  Value* binding = bindings;
+  for(; binding && typeOf(binding) == Value::Type::PAIR && binding != EmptyList;
+      binding = cdr(binding)){
+    Value* pair = car(binding);
+    if(!pair || typeOf(pair) != Value::Type::PAIR || pair == EmptyList ||
+       !car(pair) || typeOf(car(pair)) != Value::Type::SYMBOL){
+      throw FaslError("Bad binding in heap image.");
+    }
+  }
+  if(binding != EmptyList){
+    throw FaslError("Bad binding in heap image.");
+  }
+  for(; bindings != EmptyList; bindings = cdr(bindings)){
+    GlobalEnvironment.setBinding(car(car(bindings)), cdr(car(bindings)));
+  }
+}
+
+/***** Primitive Procedures *****/
+// (dump-image "file")
+Value* dumpImageProc(Value** args, size_t){
+  if(typeOf(args[0]) != Value::Type::STRING){
+    throw EvaluationError("File names must be strings.");
+  }
+  dumpImage(args[0]->str.str);
+  return nullptr;
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+
+#include "value.hpp"
+
+namespace crisp{
+
+/***** Functions *****/
+// Saves everything reachable from the global environment: its bindings,
+// the procedures and environments they close over, their compiled code and
+// the symbol table. Booting from the image instead of calling initEval and
+// reloading libraries picks up where the dumping process left off.
+// Primitives the embedding program bound itself are left out.
+void dumpImage(const std::string& path);
+void bootImage(const std::string& path);
+
+/***** Primitive Procedures *****/
+Value* dumpImageProc(Value** args, size_t argc);
+
+}
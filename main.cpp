@@ -3,25 +3,61 @@
 #include "value.hpp"
 #include "read.hpp"
 #include "eval.hpp"
+#include "image.hpp"
+#include "port.hpp"
 
 using namespace std;
 using namespace crisp;
 
-int main(int, char*[]) {
-  cout << "Welcome to Crisp. Use ctrl-c to exit.\n";
+int main(int argc, char* argv[]) {
+  // crisp --image file starts from a heap image saved with dump-image
+  if(argc > 2 && string(argv[1]) == "--image"){
+    try{
+      bootImage(argv[2]);
+    } catch(const exception& e){
+      cerr << argv[2] << ": " << e.what() << endl;
+      return 1;
+    }
+    argc -= 2;
+    argv += 2;
+  } else {
+    initEval();
+  }
+
+  // crisp file.scm runs the file instead of starting a REPL
+  if(argc > 1){
+    try{
+      loadFile(argv[1]);
+    } catch(const exception& e){
+      cerr << argv[1] << ": " << e.what() << endl;
+      return 1;
+    }
+    return 0;
+  }
 
-  initEval();
+  auto& out = standardOutput();
+  out.write("Welcome to Crisp. Use ctrl-c to exit.\n");
 
+  // one reader for the whole session, so several forms on a line are all
+  // evaluated, and a bad one is skipped without losing the rest
+  StreamSource source{cin};
+  Reader reader{source};
   while(true){
-    cout << "crisp> ";
+    out.write("crisp> ");
+    // the prompt has to be out before we block reading the next line
+    out.flush();
     try{
-      print(doEval(doRead(cin)));
+      Value* form = reader.next();
+      if(!form){
+        break;
+      }
+      print(doEval(form), out);
     } catch(const exception& e){
-      cout << e.what();
-      cin.clear();
-      cin.ignore(numeric_limits<streamsize>::max(), '\n');
+      out.write(e.what());
     }
-    cout << endl;
+    out.put('\n');
   }
+  out.put('\n');
+  out.flush();
   return 0;
 }
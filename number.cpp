@@ -0,0 +1,330 @@
+#include <algorithm>
+#include <utility>
+
+#include "number.hpp"
+#include "value.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+using Limb = Bignum::Limb;
+using Magnitude = vector<Limb>;
+
+constexpr unsigned LimbBits = 32;
+// below this many limbs in the shorter operand, schoolbook multiplication
+// beats splitting
+constexpr size_t KaratsubaThreshold = 32;
+// the most decimal digits that fit in a limb, converted a chunk at a time
+constexpr Limb DecimalChunk = 1000000000;
+constexpr size_t DecimalChunkDigits = 9;
+
+void trim(Magnitude& m){
+  while(!m.empty() && m.back() == 0){
+    m.pop_back();
+  }
+}
+
+int compareMagnitudes(const Magnitude& x, const Magnitude& y){
+  if(x.size() != y.size()){
+    return x.size() < y.size() ? -1 : 1;
+  }
+  for(size_t i = x.size(); i > 0; --i){
+    if(x[i - 1] != y[i - 1]){
+      return x[i - 1] < y[i - 1] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+// x += y << (shift limbs), x growing as needed
+void addInto(Magnitude& x, const Limb* y, size_t length, size_t shift = 0){
+  if(x.size() < shift + length){
+    x.resize(shift + length, 0);
+  }
+  uint64_t carry = 0;
+  size_t i = 0;
+  for(; i < length; ++i){
+    carry += uint64_t{x[shift + i]} + y[i];
+    x[shift + i] = static_cast<Limb>(carry);
+    carry >>= LimbBits;
+  }
+  for(size_t j = shift + i; carry; ++j){
+    if(j == x.size()){
+      x.push_back(0);
+    }
+    carry += x[j];
+    x[j] = static_cast<Limb>(carry);
+    carry >>= LimbBits;
+  }
+}
+
+// x -= y, which can't be bigger
+void subtractFrom(Magnitude& x, const Limb* y, size_t length){
+  int64_t borrow = 0;
+  size_t i = 0;
+  for(; i < length; ++i){
+    borrow += int64_t{x[i]} - y[i];
+    x[i] = static_cast<Limb>(borrow);
+    borrow >>= LimbBits;
+  }
+  for(; borrow; ++i){
+    borrow += x[i];
+    x[i] = static_cast<Limb>(borrow);
+    borrow >>= LimbBits;
+  }
+  trim(x);
+}
+
+void schoolbook(const Limb* x, size_t x_length, const Limb* y, size_t y_length,
+                Magnitude& product){
+  product.assign(x_length + y_length, 0);
+  for(size_t i = 0; i < x_length; ++i){
+    uint64_t carry = 0;
+    for(size_t j = 0; j < y_length; ++j){
+      carry += uint64_t{x[i]} * y[j] + product[i + j];
+      product[i + j] = static_cast<Limb>(carry);
+      carry >>= LimbBits;
+    }
+    product[i + y_length] = static_cast<Limb>(carry);
+  }
+  trim(product);
+}
+
+// Splits both operands at half the longer one's length, x = x1 B + x0 and
+// y = y1 B + y0, and makes do with three half size products:
+// x y = x1 y1 B^2 + ((x0 + x1)(y0 + y1) - x0 y0 - x1 y1) B + x0 y0.
+// When y is too short to split, x is split on its own.
+void multiply(const Limb* x, size_t x_length, const Limb* y, size_t y_length,
+              Magnitude& product){
+  if(x_length < y_length){
+    swap(x, y);
+    swap(x_length, y_length);
+  }
+  if(y_length < KaratsubaThreshold){
+    schoolbook(x, x_length, y, y_length, product);
+    return;
+  }
+  size_t half = x_length / 2;
+  if(y_length <= half){
+    Magnitude high;
+    multiply(x, half, y, y_length, product);
+    multiply(x + half, x_length - half, y, y_length, high);
+    addInto(product, high.data(), high.size(), half);
+    trim(product);
+    return;
+  }
+
+  Magnitude low, high, middle;
+  multiply(x, half, y, half, low);
+  multiply(x + half, x_length - half, y + half, y_length - half, high);
+  Magnitude x_sum(x, x + half);
+  trim(x_sum);
+  addInto(x_sum, x + half, x_length - half);
+  Magnitude y_sum(y, y + half);
+  trim(y_sum);
+  addInto(y_sum, y + half, y_length - half);
+  multiply(x_sum.data(), x_sum.size(), y_sum.data(), y_sum.size(), middle);
+  subtractFrom(middle, low.data(), low.size());
+  subtractFrom(middle, high.data(), high.size());
+
+  product = move(low);
+  addInto(product, middle.data(), middle.size(), half);
+  addInto(product, high.data(), high.size(), 2 * half);
+  trim(product);
+}
+
+// m = m * factor + addend
+void multiplyAdd(Magnitude& m, Limb factor, Limb addend){
+  uint64_t carry = addend;
+  for(auto& limb : m){
+    carry += uint64_t{limb} * factor;
+    limb = static_cast<Limb>(carry);
+    carry >>= LimbBits;
+  }
+  if(carry){
+    m.push_back(static_cast<Limb>(carry));
+  }
+}
+
+// m /= divisor, returning the remainder
+Limb divideSmall(Magnitude& m, Limb divisor){
+  uint64_t remainder = 0;
+  for(size_t i = m.size(); i > 0; --i){
+    uint64_t current = (remainder << LimbBits) | m[i - 1];
+    m[i - 1] = static_cast<Limb>(current / divisor);
+    remainder = current % divisor;
+  }
+  trim(m);
+  return static_cast<Limb>(remainder);
+}
+
+// the sum of two integers, each given as a sign and magnitude
+Bignum addSigned(const Magnitude& x, bool x_negative, const Magnitude& y, bool y_negative){
+  if(x_negative == y_negative){
+    Magnitude sum(x);
+    addInto(sum, y.data(), y.size());
+    return Bignum{move(sum), x_negative};
+  }
+  // opposite signs: the smaller magnitude comes off the larger
+  if(compareMagnitudes(x, y) >= 0){
+    Magnitude difference(x);
+    subtractFrom(difference, y.data(), y.size());
+    return Bignum{move(difference), x_negative};
+  }
+  Magnitude difference(y);
+  subtractFrom(difference, x.data(), x.size());
+  return Bignum{move(difference), y_negative};
+}
+
+} // end unnamed namespace
+
+/***** Bignums *****/
+Bignum::Bignum(long n) : limbs_{}, negative_{n < 0} {
+  // through unsigned, so the most negative fixnum negates
+  unsigned long magnitude = n < 0 ? 0 - static_cast<unsigned long>(n) : n;
+  for(; magnitude; magnitude >>= LimbBits){
+    limbs_.push_back(static_cast<Limb>(magnitude));
+  }
+}
+
+Bignum::Bignum(vector<Limb> limbs, bool negative)
+    : limbs_{move(limbs)}, negative_{negative} {
+  trim(limbs_);
+  // there's no negative zero
+  negative_ = negative_ && !limbs_.empty();
+}
+
+Bignum Bignum::fromDecimal(const char* begin, const char* end){
+  bool negative = begin != end && *begin == '-';
+  if(negative){
+    ++begin;
+  }
+  Magnitude m;
+  // the first chunk takes whatever's left over, the rest are full
+  size_t first = (end - begin) % DecimalChunkDigits;
+  if(first == 0){
+    first = DecimalChunkDigits;
+  }
+  for(const char* chunk = begin; chunk < end;){
+    const char* chunk_end = chunk + (chunk == begin ? first : DecimalChunkDigits);
+    Limb value = 0;
+    Limb scale = 1;
+    for(; chunk != chunk_end; ++chunk){
+      value = value * 10 + (*chunk - '0');
+      scale *= 10;
+    }
+    multiplyAdd(m, scale, value);
+  }
+  return Bignum{move(m), negative};
+}
+
+bool Bignum::fitsFixnum() const {
+  if(limbs_.size() > 2){
+    return false;
+  }
+  unsigned long magnitude = 0;
+  for(size_t i = limbs_.size(); i > 0; --i){
+    magnitude = (magnitude << LimbBits) | limbs_[i - 1];
+  }
+  unsigned long limit = static_cast<unsigned long>(FixnumMax);
+  return magnitude <= limit + negative_;
+}
+
+long Bignum::toFixnum() const {
+  unsigned long magnitude = 0;
+  for(size_t i = limbs_.size(); i > 0; --i){
+    magnitude = (magnitude << LimbBits) | limbs_[i - 1];
+  }
+  return negative_ ? static_cast<long>(0 - magnitude) : static_cast<long>(magnitude);
+}
+
+string Bignum::toDecimal() const {
+  if(limbs_.empty()){
+    return "0";
+  }
+  // chunks of nine digits come out least significant first
+  Magnitude m(limbs_);
+  vector<Limb> chunks;
+  while(!m.empty()){
+    chunks.push_back(divideSmall(m, DecimalChunk));
+  }
+  string digits = negative_ ? "-" : "";
+  digits += to_string(chunks.back());
+  for(size_t i = chunks.size() - 1; i > 0; --i){
+    string chunk = to_string(chunks[i - 1]);
+    digits.append(DecimalChunkDigits - chunk.size(), '0');
+    digits += chunk;
+  }
+  return digits;
+}
+
+int Bignum::compare(const Bignum& other) const {
+  if(negative_ != other.negative_){
+    return negative_ ? -1 : 1;
+  }
+  int magnitude = compareMagnitudes(limbs_, other.limbs_);
+  return negative_ ? -magnitude : magnitude;
+}
+
+Bignum Bignum::operator-() const {
+  return Bignum{limbs_, !negative_};
+}
+
+Bignum operator+(const Bignum& x, const Bignum& y){
+  return addSigned(x.limbs_, x.negative_, y.limbs_, y.negative_);
+}
+
+Bignum operator-(const Bignum& x, const Bignum& y){
+  return addSigned(x.limbs_, x.negative_, y.limbs_, !y.negative_);
+}
+
+Bignum operator*(const Bignum& x, const Bignum& y){
+  if(x.isZero() || y.isZero()){
+    return Bignum{};
+  }
+  Magnitude product;
+  multiply(x.limbs_.data(), x.limbs_.size(), y.limbs_.data(), y.limbs_.size(), product);
+  return Bignum{move(product), x.negative_ != y.negative_};
+}
+
+/***** Integers *****/
+Bignum toBignum(Value* integer){
+  if(typeOf(integer) == Value::Type::FIXNUM){
+    return Bignum{fixnumValue(integer)};
+  }
+  return *integer->bignum;
+}
+
+Value* makeInteger(Bignum n){
+  if(n.fitsFixnum()){
+    return makeFixnum(n.toFixnum());
+  }
+  return new Value(new Bignum(move(n)));
+}
+
+Value* makeInteger(long n){
+  if(n >= FixnumMin && n <= FixnumMax){
+    return makeFixnum(n);
+  }
+  return new Value(new Bignum(n));
+}
+
+Value* addIntegersSlow(Value* x, Value* y){
+  return makeInteger(toBignum(x) + toBignum(y));
+}
+
+Value* subtractIntegersSlow(Value* x, Value* y){
+  return makeInteger(toBignum(x) - toBignum(y));
+}
+
+Value* multiplyIntegersSlow(Value* x, Value* y){
+  return makeInteger(toBignum(x) * toBignum(y));
+}
+
+int compareIntegersSlow(Value* x, Value* y){
+  return toBignum(x).compare(toBignum(y));
+}
+
+}
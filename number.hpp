@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "value.hpp"
+
+namespace crisp{
+
+/***** Classes *****/
+// An integer of any size: a sign and a magnitude in 32 bit limbs, least
+// significant first, with no high zero limbs (so zero has none). BIGNUM
+// values are only made for integers that don't fit in a fixnum.
+class Bignum{
+  public:
+    using Limb = uint32_t;
+
+    Bignum() : limbs_{}, negative_{false} {}
+    explicit Bignum(long n);
+    Bignum(std::vector<Limb> limbs, bool negative);
+    // [begin, end) is decimal digits, possibly after a minus sign
+    static Bignum fromDecimal(const char* begin, const char* end);
+
+    bool negative() const { return negative_; }
+    bool isZero() const { return limbs_.empty(); }
+    const std::vector<Limb>& limbs() const { return limbs_; }
+    bool fitsFixnum() const;
+    // only when it fits
+    long toFixnum() const;
+    std::string toDecimal() const;
+    // less than, equal to or greater than zero as this is to other
+    int compare(const Bignum& other) const;
+
+    Bignum operator-() const;
+    friend Bignum operator+(const Bignum& x, const Bignum& y);
+    friend Bignum operator-(const Bignum& x, const Bignum& y);
+    // Karatsuba once both operands are long enough, schoolbook below that
+    friend Bignum operator*(const Bignum& x, const Bignum& y);
+
+  private:
+    std::vector<Limb> limbs_;
+    bool negative_;
+};
+
+/***** Functions *****/
+// fixnums and bignums
+inline bool isInteger(Value* value){
+  return isFixnum(value) || typeOf(value) == Value::Type::BIGNUM;
+}
+
+Bignum toBignum(Value* integer);
+// a fixnum when it fits, so each integer has one representation
+Value* makeInteger(Bignum n);
+Value* makeInteger(long n);
+
+// Integer arithmetic on fixnums and bignums. Two fixnums whose result
+// fits take the fast path, working on the tagged words themselves: with
+// the tag bit set, x + y - 1 is the sum and x - y + 1 the difference, so
+// the processor's overflow flag says whether the result still fits.
+// Overflow carries on in bignums.
+Value* addIntegersSlow(Value* x, Value* y);
+Value* subtractIntegersSlow(Value* x, Value* y);
+Value* multiplyIntegersSlow(Value* x, Value* y);
+int compareIntegersSlow(Value* x, Value* y);
+
+inline Value* addIntegers(Value* x, Value* y){
+  long n;
+  if(isFixnum(x) && isFixnum(y) &&
+     !__builtin_add_overflow(static_cast<long>(wordOf(x)), static_cast<long>(wordOf(y) - FixnumTag), &n)){
+    return valueOf(static_cast<uintptr_t>(n));
+  }
+  return addIntegersSlow(x, y);
+}
+
+inline Value* subtractIntegers(Value* x, Value* y){
+  long n;
+  if(isFixnum(x) && isFixnum(y) &&
+     !__builtin_sub_overflow(static_cast<long>(wordOf(x)), static_cast<long>(wordOf(y) - FixnumTag), &n)){
+    return valueOf(static_cast<uintptr_t>(n));
+  }
+  return subtractIntegersSlow(x, y);
+}
+
+// one operand untagged, the other shifted: twice the product, then the tag
+inline Value* multiplyIntegers(Value* x, Value* y){
+  long n;
+  if(isFixnum(x) && isFixnum(y) &&
+     !__builtin_mul_overflow(fixnumValue(x), static_cast<long>(wordOf(y) - FixnumTag), &n)){
+    return valueOf(static_cast<uintptr_t>(n) | FixnumTag);
+  }
+  return multiplyIntegersSlow(x, y);
+}
+
+// tagged words order the same way as the fixnums in them
+inline int compareIntegers(Value* x, Value* y){
+  if(isFixnum(x) && isFixnum(y)){
+    long a = static_cast<long>(wordOf(x));
+    long b = static_cast<long>(wordOf(y));
+    return (a > b) - (a < b);
+  }
+  return compareIntegersSlow(x, y);
+}
+
+}
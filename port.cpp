@@ -0,0 +1,100 @@
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "port.hpp"
+#include "exception.hpp"
+
+using namespace std;
+
+namespace crisp{
+
+/***** Output Ports *****/
+OutputPort::OutputPort(size_t capacity) : buffer_(capacity), used_{0} {}
+
+void OutputPort::write(const char* data, size_t size){
+  if(size > buffer_.size() - used_){
+    flush();
+    // too big to be worth buffering
+    if(size >= buffer_.size()){
+      drain(data, size);
+      return;
+    }
+  }
+  memcpy(buffer_.data() + used_, data, size);
+  used_ += size;
+}
+
+void OutputPort::write(const char* str){
+  write(str, strlen(str));
+}
+
+void OutputPort::writeFixnum(long n){
+  char digits[24];
+  char* end = digits + sizeof(digits);
+  char* start = end;
+  // through unsigned, so the most negative fixnum negates
+  unsigned long magnitude = n < 0 ? 0 - static_cast<unsigned long>(n) : n;
+  do{
+    *--start = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while(magnitude);
+  if(n < 0){
+    *--start = '-';
+  }
+  write(start, end - start);
+}
+
+void OutputPort::flush(){
+  if(used_ > 0){
+    // emptied first, so a drain that throws doesn't write the same output
+    // twice
+    size_t used = used_;
+    used_ = 0;
+    drain(buffer_.data(), used);
+  }
+}
+
+FileDescriptorPort::~FileDescriptorPort(){
+  try{
+    flush();
+  } catch(const exception&){
+    // nowhere left to report it
+  }
+}
+
+void FileDescriptorPort::drain(const char* data, size_t size){
+  while(size > 0){
+    auto count = ::write(fd_, data, size);
+    if(count < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      throw VerboseError("Output error: ", "Unable to write to file.");
+    }
+    data += count;
+    size -= count;
+  }
+}
+
+const string& StringPort::str(){
+  flush();
+  return contents_;
+}
+
+void StringPort::clear(){
+  flush();
+  contents_.clear();
+}
+
+void StringPort::drain(const char* data, size_t size){
+  contents_.append(data, size);
+}
+
+OutputPort& standardOutput(){
+  static FileDescriptorPort port{STDOUT_FILENO};
+  return port;
+}
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace crisp{
+
+/***** Classes *****/
+// Somewhere output goes. Writes collect in a buffer that's only handed on
+// when it fills up or the port is flushed, so printing a large value costs
+// a few big writes rather than one per token.
+class OutputPort{
+  public:
+    explicit OutputPort(size_t capacity = 1 << 16);
+    virtual ~OutputPort() = default;
+    OutputPort(const OutputPort&) = delete;
+    OutputPort& operator=(const OutputPort&) = delete;
+
+    void write(const char* data, size_t size);
+    void write(const char* str);
+    void write(const std::string& str) { write(str.data(), str.size()); }
+    void put(char ch){
+      if(used_ == buffer_.size()){
+        flush();
+      }
+      buffer_[used_++] = ch;
+    }
+    void writeFixnum(long n);
+    void flush();
+
+  protected:
+    // hand buffered output on to wherever the port goes
+    virtual void drain(const char* data, size_t size) = 0;
+
+  private:
+    std::vector<char> buffer_;
+    size_t used_;
+};
+
+// Writes to a file descriptor, flushing what's left when it's destroyed.
+class FileDescriptorPort : public OutputPort{
+  public:
+    explicit FileDescriptorPort(int fd) : fd_{fd} {}
+    ~FileDescriptorPort() override;
+  protected:
+    void drain(const char* data, size_t size) override;
+  private:
+    int fd_;
+};
+
+// Collects everything written to it in memory.
+class StringPort : public OutputPort{
+  public:
+    StringPort() : OutputPort(4096) {}
+    // everything written so far
+    const std::string& str();
+    void clear();
+  protected:
+    void drain(const char* data, size_t size) override;
+  private:
+    std::string contents_;
+};
+
+/***** Functions *****/
+// standard output, which the REPL and print without a port write to
+OutputPort& standardOutput();
+
+}
@@ -1,12 +1,22 @@
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cerrno>
 #include <cstring>
 #include <iostream>
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "read.hpp"
+#include "number.hpp"
+#include "scan.hpp"
 #include "value.hpp"
 #include "eval.hpp"
 
@@ -14,217 +24,651 @@ using namespace std;
 
 namespace crisp{
 
-bool isDelimiter(char c){
-  return c == '\0' || isspace(c) || (string{"()[]\";#"}.find(c) != string::npos);
+namespace { // unnamed namespace
+
+/***** Lexer Tables *****/
+// Everything the lexer needs to know about a byte.
+enum CharClass : uint8_t {
+  C_OTHER,
+  C_WHITESPACE,
+  C_NEWLINE,
+  C_DIGIT,
+  C_MINUS,
+  C_LETTER,
+  C_T_OR_F,       // can follow # in a boolean, otherwise a letter
+  C_INITIAL,      // the other characters that can start a symbol
+  C_SUBSEQUENT,   // characters that can only continue one
+  C_DOT,
+  C_HASH,
+  C_BACKSLASH,
+  C_DOUBLE_QUOTE,
+  C_LPAREN,
+  C_RPAREN,
+  C_QUOTE,
+  C_BACKTICK,
+  C_COMMA,
+  C_AT,           // continues a symbol, or makes a comma ,@
+  C_SEMICOLON,
+  C_BRACKET,
+  C_END,          // not a byte, the end of the input
+  CLASS_COUNT
+};
+
+// Lexer states come first. Everything from STATE_COUNT on stops the lexer:
+// accepting a token that ends before the current byte (A_*), one that ends
+// with it (T_*), or failing (E_*).
+enum State : uint8_t {
+  S_START,
+  S_COMMENT,
+  S_MINUS,
+  S_NUMBER,
+  S_SYMBOL,
+  S_HASH,
+  S_BOOLEAN,
+  S_CHAR_START,
+  S_CHAR_NAME,
+  S_STRING,
+  S_STRING_ESCAPE,
+  S_STRING_END,
+  S_COMMA,
+  STATE_COUNT,
+  A_NUMBER = STATE_COUNT,
+  A_SYMBOL,
+  A_BOOLEAN,
+  A_CHARACTER,
+  A_STRING,
+  T_LPAREN,
+  T_RPAREN,
+  T_QUOTE,
+  T_BACKTICK,
+  A_COMMA,
+  T_COMMA_AT,
+  E_END,
+  E_NON_NUMERIC,
+  E_SYMBOL,
+  E_LITERAL,
+  E_MISSING_CHARACTER,
+  E_DELIMITER,
+  E_UNTERMINATED,
+  E_DOT,
+  E_INVALID
+};
+
+struct ClassTable{
+  uint8_t classes[256];
+};
+
+struct TransitionTable{
+  uint8_t next[STATE_COUNT][CLASS_COUNT];
+};
+
+constexpr bool contains(const char* chars, int ch){
+  for(; *chars; ++chars){
+    if(*chars == ch){
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr ClassTable makeClassTable(){
+  ClassTable table{};
+  for(int ch = 0; ch < 256; ++ch){
+    uint8_t cls = C_OTHER;
+    if(ch == '\n'){
+      cls = C_NEWLINE;
+    } else if(contains(" \t\r\v\f", ch)){
+      cls = C_WHITESPACE;
+    } else if(ch >= '0' && ch <= '9'){
+      cls = C_DIGIT;
+    } else if(ch == 't' || ch == 'f'){
+      cls = C_T_OR_F;
+    } else if((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')){
+      cls = C_LETTER;
+    } else if(ch == '-'){
+      cls = C_MINUS;
+    } else if(contains("!$%&*/:<=>?^_~", ch)){
+      cls = C_INITIAL;
+    } else if(ch == '@'){
+      cls = C_AT;
+    } else if(ch == '+'){
+      cls = C_SUBSEQUENT;
+    } else if(ch == '.'){
+      cls = C_DOT;
+    } else if(ch == '#'){
+      cls = C_HASH;
+    } else if(ch == '\\'){
+      cls = C_BACKSLASH;
+    } else if(ch == '"'){
+      cls = C_DOUBLE_QUOTE;
+    } else if(ch == '('){
+      cls = C_LPAREN;
+    } else if(ch == ')'){
+      cls = C_RPAREN;
+    } else if(ch == '\''){
+      cls = C_QUOTE;
+    } else if(ch == '`'){
+      cls = C_BACKTICK;
+    } else if(ch == ','){
+      cls = C_COMMA;
+    } else if(ch == ';'){
+      cls = C_SEMICOLON;
+    } else if(ch == '[' || ch == ']'){
+      cls = C_BRACKET;
+    }
+    table.classes[ch] = cls;
+  }
+  return table;
+}
+
+// what ends a number, symbol or literal
+constexpr bool delimits(int cls){
+  return cls == C_WHITESPACE || cls == C_NEWLINE || cls == C_LPAREN || cls == C_RPAREN ||
+         cls == C_DOUBLE_QUOTE || cls == C_SEMICOLON || cls == C_HASH ||
+         cls == C_BRACKET || cls == C_END;
+}
+
+constexpr bool continuesSymbol(int cls){
+  return cls == C_LETTER || cls == C_T_OR_F || cls == C_DIGIT || cls == C_MINUS ||
+         cls == C_INITIAL || cls == C_SUBSEQUENT || cls == C_AT || cls == C_DOT;
+}
+
+constexpr TransitionTable makeTransitionTable(){
+  TransitionTable table{};
+  for(int cls = 0; cls < CLASS_COUNT; ++cls){
+    // skip whitespace and comments, then pick the kind of token
+    uint8_t start = E_INVALID;
+    switch(cls){
+      case C_WHITESPACE: case C_NEWLINE: start = S_START; break;
+      case C_SEMICOLON: start = S_COMMENT; break;
+      case C_DIGIT: start = S_NUMBER; break;
+      case C_MINUS: start = S_MINUS; break;
+      case C_LETTER: case C_T_OR_F: case C_INITIAL: start = S_SYMBOL; break;
+      case C_HASH: start = S_HASH; break;
+      case C_DOUBLE_QUOTE: start = S_STRING; break;
+      case C_LPAREN: start = T_LPAREN; break;
+      case C_RPAREN: start = T_RPAREN; break;
+      case C_QUOTE: start = T_QUOTE; break;
+      case C_BACKTICK: start = T_BACKTICK; break;
+      case C_COMMA: start = S_COMMA; break;
+      case C_DOT: start = E_DOT; break;
+      case C_END: start = E_END; break;
+      default: break;
+    }
+    table.next[S_START][cls] = start;
+    table.next[S_COMMENT][cls] = cls == C_NEWLINE ? S_START : cls == C_END ? E_END : S_COMMENT;
+
+    // a lone minus is a symbol
+    table.next[S_MINUS][cls] = cls == C_DIGIT ? S_NUMBER : delimits(cls) ? A_SYMBOL : E_NON_NUMERIC;
+    table.next[S_NUMBER][cls] = cls == C_DIGIT ? S_NUMBER : delimits(cls) ? A_NUMBER : E_NON_NUMERIC;
+    table.next[S_SYMBOL][cls] = continuesSymbol(cls) ? S_SYMBOL : delimits(cls) ? A_SYMBOL : E_SYMBOL;
+
+    table.next[S_HASH][cls] = cls == C_T_OR_F ? S_BOOLEAN : cls == C_BACKSLASH ? S_CHAR_START : E_LITERAL;
+    table.next[S_BOOLEAN][cls] = delimits(cls) ? A_BOOLEAN : E_DELIMITER;
+    // any character at all follows #\, possibly starting a name like newline
+    table.next[S_CHAR_START][cls] = cls == C_END ? E_MISSING_CHARACTER : S_CHAR_NAME;
+    table.next[S_CHAR_NAME][cls] = (cls == C_LETTER || cls == C_T_OR_F) ? S_CHAR_NAME :
+                                   delimits(cls) ? A_CHARACTER : E_DELIMITER;
+
+    table.next[S_STRING][cls] = cls == C_BACKSLASH ? S_STRING_ESCAPE :
+                                cls == C_DOUBLE_QUOTE ? S_STRING_END :
+                                cls == C_END ? E_UNTERMINATED : S_STRING;
+    table.next[S_STRING_ESCAPE][cls] = cls == C_END ? E_UNTERMINATED : S_STRING;
+    table.next[S_STRING_END][cls] = delimits(cls) ? A_STRING : E_DELIMITER;
+    table.next[S_COMMA][cls] = cls == C_AT ? T_COMMA_AT : A_COMMA;
+  }
+  return table;
 }
 
-Value* read(Environment* envt){
-  auto input = envt->getSymbolBinding("input");
-  if(!input){
-    throw EvaluationError("Cannot get input binding.");
+constexpr ClassTable Classes = makeClassTable();
+constexpr TransitionTable Transitions = makeTransitionTable();
+
+inline uint8_t classOf(char ch){
+  return Classes.classes[static_cast<unsigned char>(ch)];
+}
+
+Value* characterNamed(Span name){
+  if(name.size() == 1){
+    return makeCharacter(*name.begin);
+  }
+  string str{name.begin, name.end};
+  if(str == "newline"){
+    return makeCharacter('\n');
+  } else if(str == "space"){
+    return makeCharacter(' ');
+  } else if(str == "tab"){
+    return makeCharacter('\t');
   }
-  if(input->type != Value::Type::STRING){
+  throw LexingError("Unknown character name.");
+}
+
+// the contents of a string literal with its escapes replaced
+Value* makeString(Span contents){
+  if(!memchr(contents.begin, '\\', contents.size())){
+    Value::Str s{contents.begin, contents.size()};
+    return new Value(s);
+  }
+  string str;
+  str.reserve(contents.size());
+  for(const char* ch = contents.begin; ch != contents.end; ++ch){
+    if(*ch != '\\'){
+      str.push_back(*ch);
+      continue;
+    }
+    switch(*++ch){
+      case 'n': str.push_back('\n'); break;
+      case 't': str.push_back('\t'); break;
+      case '\\': str.push_back('\\'); break;
+      case '"': str.push_back('"'); break;
+      default: throw LexingError("Unknown escape in string.");
+    }
+  }
+  Value::Str s{str.data(), str.size()};
+  return new Value(s);
+}
+
+// A list being read, or a quote waiting for the datum it applies to.
+struct Pending{
+  Value* head;  // the list so far
+  Value* tail;  // its last pair, null while it's empty
+  Value* quote; // the quoting symbol, for a quote
+};
+
+} // end unnamed namespace
+
+bool isDelimiter(char c){
+  return c == '\0' || delimits(classOf(c));
+}
+
+Value* read(Value** args, size_t){
+  auto input = args[0];
+  if(typeOf(input) != Value::Type::STRING){
     throw EvaluationError("Unable to read anything but a string.");
   }
-  return get<0>(readElement(input->str.str));
+  const char* str = input->str.str;
+  return get<0>(readElement(str, str + strlen(str)));
 }
 
-tuple<Value*, char*> readElement(char* input){
+// Reads one datum without recursing: lists being read and quotes waiting
+// for their datum are kept on an explicit stack, and each list grows at its
+// tail, so neither long lists nor deep nesting use up the C++ stack.
+tuple<Value*, const char*> readElement(const char* input, const char* end){
   // attempt to read token, throw exception if failure
-  if(strlen(input) == 0){
+  if(input == end){
     throw EvaluationError("Unable to read token from empty string.");
   }
-  Token token_type;
-  string token_contents;
-  char* rest;
-  tie(token_type, token_contents, rest) = readToken(input);
-  Value* result = nullptr;
-  switch(token_type){
-    case Token::NUMBER:{
-      result = new Value(stol(token_contents));
-    } break;
-    case Token::BOOLEAN:{
-      if(token_contents == "#f"){
-        result = &False;
+  vector<Pending> pending;
+  const char* rest = input;
+  while(true){
+    Token token_type;
+    Span token;
+    tie(token_type, token, rest) = readToken(rest, end);
+    Value* datum = nullptr;
+    switch(token_type){
+      case Token::NUMBER:{
+        datum = parseInteger(token);
+      } break;
+      case Token::BOOLEAN:{
+        datum = makeBoolean(token.end[-1] == 't');
+      } break;
+      case Token::CHARACTER:{
+        // skip the #\ prefix
+        datum = characterNamed(Span{token.begin + 2, token.end});
+      } break;
+      case Token::STRING:{
+        // the span covers the quotes
+        datum = makeString(Span{token.begin + 1, token.end - 1});
+      } break;
+      case Token::SYMBOL:{
+        datum = getInternedSymbol(token.begin, token.size());
+      } break;
+      case Token::LPAREN:{
+        pending.push_back(Pending{EmptyList, nullptr, nullptr});
+      } continue;
+      case Token::QUOTE:{
+        pending.push_back(Pending{nullptr, nullptr, getInternedSymbol("quote")});
+      } continue;
+      case Token::BACKTICK:{
+        pending.push_back(Pending{nullptr, nullptr, getInternedSymbol("quasiquote")});
+      } continue;
+      case Token::COMMA:{
+        pending.push_back(Pending{nullptr, nullptr, getInternedSymbol("unquote")});
+      } continue;
+      case Token::COMMA_AT:{
+        pending.push_back(Pending{nullptr, nullptr, getInternedSymbol("unquote-splicing")});
+      } continue;
+      case Token::RPAREN:{
+        if(pending.empty()){
+          return {nullptr, rest}; // indicate that we're finished with a list
+        }
+        if(pending.back().quote){
+          throw ParsingError("Unexpected close paren.");
+        }
+        datum = pending.back().head;
+        pending.pop_back();
+      } break;
+    }
+
+    // hand the finished datum to whatever is waiting for it
+    while(true){
+      if(pending.empty()){
+        return {datum, rest};
+      }
+      Pending& top = pending.back();
+      if(top.quote){
+        datum = makePair(top.quote, makePair(datum, EmptyList));
+        pending.pop_back();
+        continue;
+      }
+      Value* pair = makePair(datum, EmptyList);
+      if(top.tail){
+        cdr(top.tail) = pair;
       } else {
-        result = &True;
+        top.head = pair;
       }
-    } break;
-    case Token::CHARACTER:{
-      result = new Value(token_contents.back());
-    } break;
-    case Token::STRING:{
-      Value::Str s{token_contents.c_str()};
-      result = new Value(s);
-    } break;
-    case Token::LPAREN:{
-      tie(result, rest) = readList(rest, EmptyList);
-    } break;
-    case Token::SYMBOL:{
-      result = getInternedSymbol(token_contents);
-    } break;
-    case Token::RPAREN:{
-      result = nullptr; // indicate that we're finished with a list
-    } break;
-    case Token::QUOTE:{
-      Value* quoted;
-      tie(quoted, rest) = readElement(rest);
-      result = new Value(getInternedSymbol("quote"), new Value(quoted, EmptyList));
-    } break;
-    case Token::BACKTICK:{
-      Value* quasiquoted;
-      tie(quasiquoted, rest) = readElement(rest);
-      result = new Value(getInternedSymbol("quasiquote"), new Value(quasiquoted, EmptyList));
-    } break;
-    case Token::COMMA:{
-      Value* unquoted;
-      tie(unquoted, rest) = readElement(rest);
-      result = new Value(getInternedSymbol("unquote"), new Value(unquoted, EmptyList));
-    } break;
-  }
-  return {result, rest};
-}
-
-tuple<Value*, char*> readList(char* input, Value* list_so_far){
-  Value* v;
-  char* rest;
-  tie(v, rest) = readElement(input);
-  if(v){
-    Value* new_list = new Value(v, list_so_far);
-    return readList(rest, new_list);
-  } else {
-    auto l = list_so_far;
-    return {reverse(l), rest};
-  }
-}
-
-tuple<Token, string, char*> readLiteral(char* input) {
-  if(strlen(input) == 0){
-    throw EvaluationError("Unable to read token from empty string.");
+      top.tail = pair;
+      break;
+    }
   }
-  char ch = input[0];
-  char* rest = &input[1];
-  if(ch == 't'){
-    if(isDelimiter(rest[0])){
-      return make_tuple(Token::BOOLEAN, string{"#t"}, rest);
-    }
-    throw LexingError("Missing delimiter.");
-  } else if(ch == 'f'){
-    if(isDelimiter(rest[0])){
-      return make_tuple(Token::BOOLEAN, string{"#f"}, rest);
-    }
-    throw LexingError("Missing delimiter.");
-  } else if(ch == '\\'){
-    ch = rest[0];
-    rest = &rest[1];
-    if(isDelimiter(rest[1])){
-      return make_tuple(Token::CHARACTER, string{"#\\"} + ch, rest);
-    }
-    throw LexingError("Missing delimiter.");
-  } else {
-    // throw, invalid literal syntax
-    throw LexingError("Invalid literal syntax.");
-  }
-}
-
-tuple<Token, string, char*> readNumber(char* input, char first_ch) {
-  char ch;
-  string result = "";
-  result.push_back(first_ch);
-  size_t idx;
-  for(idx = 0; idx < strlen(input); ++idx){
-    ch = input[idx];
-    if(isdigit(ch)){
-      result.push_back(ch);
-    } else if(isDelimiter(ch)){
+}
+
+// a fixnum when the digits fit in one, a bignum otherwise
+Value* parseInteger(Span digits){
+  const char* ch = digits.begin;
+  bool negative = *ch == '-';
+  if(negative){
+    ++ch;
+  }
+  unsigned long magnitude = 0;
+  unsigned long limit = negative ? 0ul - static_cast<unsigned long>(FixnumMin)
+                                 : static_cast<unsigned long>(FixnumMax);
+  for(; ch != digits.end; ++ch){
+    unsigned long digit = *ch - '0';
+    if(magnitude > (limit - digit) / 10){
+      return makeInteger(Bignum::fromDecimal(digits.begin, digits.end));
+    }
+    magnitude = magnitude * 10 + digit;
+  }
+  return makeFixnum(negative ? static_cast<long>(0ul - magnitude) : static_cast<long>(magnitude));
+}
+
+// Runs the lexer's state machine from input: one class lookup and one
+// transition per byte, until a transition stops it, except for the runs
+// skipAtom and skipStringBody step over. Returns the token, its
+// text, and the value representing the remaining input.
+tuple<Token, Span, const char*> readToken(const char* input, const char* end) {
+  const char* ch = input;
+  const char* begin = input;
+  uint8_t state = S_START;
+  while(true){
+    uint8_t cls = ch == end ? uint8_t{C_END} : classOf(*ch);
+    if(state == S_START){
+      begin = ch;
+    }
+    state = Transitions.next[state][cls];
+    if(state >= STATE_COUNT){
       break;
-    } else {
-      // throw, cant have weird symbols in a number
-      throw LexingError("Non-numeric digit.");
+    }
+    ++ch;
+    // runs of symbol constituents and string contents don't change the
+    // state, so skip them in bulk
+    if(state == S_SYMBOL){
+      ch = skipAtom(ch, end);
+    } else if(state == S_STRING){
+      ch = skipStringBody(ch, end);
     }
   }
-  return make_tuple(Token::NUMBER, result, &input[idx]);
+  switch(state){
+    case A_NUMBER: return make_tuple(Token::NUMBER, Span{begin, ch}, ch);
+    case A_SYMBOL: return make_tuple(Token::SYMBOL, Span{begin, ch}, ch);
+    case A_BOOLEAN: return make_tuple(Token::BOOLEAN, Span{begin, ch}, ch);
+    case A_CHARACTER: return make_tuple(Token::CHARACTER, Span{begin, ch}, ch);
+    case A_STRING: return make_tuple(Token::STRING, Span{begin, ch}, ch);
+    case T_LPAREN: return make_tuple(Token::LPAREN, Span{begin, ch + 1}, ch + 1);
+    case T_RPAREN: return make_tuple(Token::RPAREN, Span{begin, ch + 1}, ch + 1);
+    case T_QUOTE: return make_tuple(Token::QUOTE, Span{begin, ch + 1}, ch + 1);
+    case T_BACKTICK: return make_tuple(Token::BACKTICK, Span{begin, ch + 1}, ch + 1);
+    case A_COMMA: return make_tuple(Token::COMMA, Span{begin, ch}, ch);
+    case T_COMMA_AT: return make_tuple(Token::COMMA_AT, Span{begin, ch + 1}, ch + 1);
+    case E_END: throw LexingError("Unexpected end of input.");
+    case E_NON_NUMERIC: throw LexingError("Non-numeric digit.");
+    case E_SYMBOL: throw LexingError("Invalid character for symbols.");
+    case E_LITERAL: throw LexingError("Invalid literal syntax.");
+    case E_MISSING_CHARACTER: throw LexingError("Missing character.");
+    case E_DELIMITER: throw LexingError("Missing delimiter.");
+    case E_UNTERMINATED: throw LexingError("Unterminated string.");
+    case E_DOT: throw LexingError("Cannot parse Dot Notation at this time.");
+    default: throw LexingError("Invalid character.");
+  }
 }
 
-tuple<Token, string, char*> readString(char* input) {
-  char ch;
-  string result = "";
-  size_t idx;
-  for(idx = 0; idx < strlen(input); ++idx){
-    ch = input[idx];
-    if(ch == '\"'){
-      if(isDelimiter(input[idx + 1])){
-        break;
+/***** Input Sources *****/
+size_t StreamSource::read(char* buffer, size_t size){
+  if(stream_.tie()){
+    stream_.tie()->flush();
+  }
+  auto buf = stream_.rdbuf();
+  size_t count = 0;
+  while(count < size){
+    auto ch = buf->sbumpc();
+    if(ch == char_traits<char>::eof()){
+      stream_.setstate(ios::eofbit);
+      break;
+    }
+    buffer[count++] = static_cast<char>(ch);
+    if(ch == '\n'){
+      break;
+    }
+  }
+  return count;
+}
+
+size_t FileDescriptorSource::read(char* buffer, size_t size){
+  while(true){
+    auto count = ::read(fd_, buffer, size);
+    if(count >= 0){
+      return static_cast<size_t>(count);
+    }
+    if(errno != EINTR){
+      throw ParsingError("Unable to read from file.");
+    }
+  }
+}
+
+size_t MemorySource::read(char* buffer, size_t size){
+  size_t count = min(size, size_);
+  memcpy(buffer, data_, count);
+  data_ += count;
+  size_ -= count;
+  return count;
+}
+
+MappedFile::MappedFile(const string& path) : data_{nullptr}, size_{0} {
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0){
+    throw ParsingError("Unable to open file.");
+  }
+  struct stat info;
+  if(fstat(fd, &info) < 0){
+    close(fd);
+    throw ParsingError("Unable to read from file.");
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  // mapping nothing is an error, and there's nothing to read anyway
+  if(size_ > 0){
+    void* mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapping == MAP_FAILED){
+      close(fd);
+      throw ParsingError("Unable to read from file.");
+    }
+    // the reader goes through it once, front to back
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(mapping);
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile(){
+  if(data_){
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+/***** Reader *****/
+Reader::Reader(InputSource& source)
+    : source_(&source), buffer_(4096), input_{buffer_.data()}, start_{0}, pos_{0}, end_{0},
+      started_{false}, depth_{0}, in_atom_{false}, in_string_{false}, in_comment_{false},
+      escaped_{false}, char_literal_{false}, atom_length_{0} {}
+
+Reader::Reader(const char* data, size_t size)
+    : source_(nullptr), buffer_(), input_{data}, start_{0}, pos_{0}, end_{size},
+      started_{false}, depth_{0}, in_atom_{false}, in_string_{false}, in_comment_{false},
+      escaped_{false}, char_literal_{false}, atom_length_{0} {}
+
+size_t Reader::refill(){
+  if(!source_){
+    return 0;
+  }
+  // keep the datum in progress, drop everything before it
+  size_t keep = started_ ? start_ : pos_;
+  if(keep > 0){
+    memmove(buffer_.data(), buffer_.data() + keep, end_ - keep);
+    pos_ -= keep;
+    end_ -= keep;
+    start_ = started_ ? 0 : pos_;
+  }
+  if(end_ == buffer_.size()){
+    buffer_.resize(buffer_.size() * 2);
+  }
+  input_ = buffer_.data();
+  size_t count = source_->read(buffer_.data() + end_, buffer_.size() - end_);
+  end_ += count;
+  return count;
+}
+
+bool Reader::scan(){
+  for(; pos_ < end_; ++pos_){
+    char ch = input_[pos_];
+    if(in_comment_){
+      const char* newline = static_cast<const char*>(
+          memchr(input_ + pos_, '\n', end_ - pos_));
+      if(!newline){
+        pos_ = end_;
+        return false;
+      }
+      pos_ = newline - input_;
+      in_comment_ = false;
+      continue;
+    }
+    if(in_string_){
+      if(escaped_){
+        escaped_ = false;
+      } else if(ch == '\\'){
+        escaped_ = true;
+      } else if(ch == '"'){
+        in_string_ = false;
+        if(depth_ == 0){
+          ++pos_;
+          return true;
+        }
+      } else {
+        pos_ = skipStringBody(input_ + pos_, input_ + end_) - input_ - 1;
       }
-      throw LexingError("Missing delimiter.");
+      continue;
+    }
+    if(in_atom_){
+      if(char_literal_){
+        char_literal_ = false;
+        ++atom_length_;
+        continue;
+      }
+      if(!isDelimiter(ch)){
+        // #\ is followed by the character itself, delimiter or not
+        char_literal_ = atom_length_ == 1 && input_[pos_ - 1] == '#' && ch == '\\';
+        if(!char_literal_){
+          size_t skipped = skipAtom(input_ + pos_ + 1, input_ + end_) -
+                           input_ - pos_ - 1;
+          atom_length_ += skipped;
+          pos_ += skipped;
+        }
+        ++atom_length_;
+        continue;
+      }
+      in_atom_ = false;
+      if(depth_ == 0){
+        return true;
+      }
+    }
+    uint8_t cls = classOf(ch);
+    if(cls == C_WHITESPACE || cls == C_NEWLINE){
+      continue;
+    }
+    if(ch == ';'){
+      in_comment_ = true;
+      continue;
+    }
+    if(!started_){
+      started_ = true;
+      start_ = pos_;
+    }
+    if(ch == '('){
+      ++depth_;
+    } else if(ch == ')'){
+      if(--depth_ < 0){
+        depth_ = 0;
+        started_ = false;
+        start_ = ++pos_;
+        throw ParsingError("Unexpected close paren.");
+      }
+      if(depth_ == 0){
+        ++pos_;
+        return true;
+      }
+    } else if(ch == '"'){
+      in_string_ = true;
+    } else if(ch == '@' && pos_ > start_ && input_[pos_ - 1] == ','){
+      // the rest of a ,@ prefix
+    } else if(ch != '\'' && ch != '`' && ch != ','){
+      in_atom_ = true;
+      atom_length_ = 1;
     }
-    result.push_back(ch);
   }
-  return make_tuple(Token::STRING, result, &input[idx + 1]);
+  return false;
 }
 
-tuple<Token, string, char*> readSymbol(char* input, char first_ch) {
-  string result = "";
-  result.push_back(first_ch);
-  char ch;
-  size_t idx;
-  for(idx = 0; idx < strlen(input); ++idx){
-    ch = input[idx];
-    if(isDelimiter(ch)){
-      break;
-    } else if(isalnum(ch) || 
-              (string{"!$%&*/:<=>?^_~+-.@"}.find(ch) != string::npos)){
-      result.push_back(ch);
-    } else {
-      throw LexingError("Invalid character for symbols.");
-    }
-  }
-  return make_tuple(Token::SYMBOL, result, &input[idx]);
-}
-
-// returns the token, the string, and the value representing the remaining input
-tuple<Token, string, char*> readToken(char* input) {
-  char ch = input[0];
-  char* rest = &input[1];
-  if(ch == '-' || isdigit(ch)){
-    return readNumber(rest, ch);
-  } else if(ch == '#'){
-    return readLiteral(rest);
-  } else if(ch == '"'){
-    return readString(rest);
-  } else if(ch == '('){
-    return make_tuple(Token::LPAREN, string{"("}, rest);
-  } else if(ch == ')'){
-    return make_tuple(Token::RPAREN, string{")"}, rest);
-  } else if(isspace(ch)){
-    return readToken(rest);
-  } else if(isalpha(ch) || (string{"!$%&*/:<=>?^_~"}.find(ch) != string::npos)){
-    return readSymbol(rest, ch);
-  } else if(ch == '.'){
-    throw LexingError("Cannot parse Dot Notation at this time.");
-  } else if(ch == '\''){
-    return make_tuple(Token::QUOTE, string{"'"}, rest);
-  } else if(ch == '`'){
-    return make_tuple(Token::BACKTICK, string{"`"}, rest);
-  } else if(ch == ','){
-    return make_tuple(Token::COMMA, string{","}, rest);
-  } else {
-    assert(false && "Should never be able to insert an unreadible character");
+Value* Reader::next(){
+  bool exhausted = false;
+  while(!scan()){
+    if(exhausted){
+      if(in_atom_ && depth_ == 0 && !char_literal_){
+        // an atom at the very end of the input
+        in_atom_ = false;
+        break;
+      }
+      if(started_){
+        started_ = false;
+        start_ = pos_;
+        throw ParsingError("Unexpected end of input.");
+      }
+      return nullptr;
+    }
+    exhausted = refill() == 0;
   }
+
+  const char* datum = input_ + start_;
+  const char* datum_end = input_ + pos_;
+  started_ = false;
+  start_ = pos_;
+  return get<0>(readElement(datum, datum_end));
 }
 
+// a single datum; anything the reader buffers past it is dropped, so
+// reading a series of them from one stream needs a Reader of its own
 Value* doRead(istream& input_stream){
-  string line;
-  getline(input_stream, line);
-  if(line.empty()){
-    return EmptyList;
-  }
-  Value::Str s{line.c_str()};
-  Value v{s};
-  Environment* envt = new Environment{&GlobalEnvironment};
-  envt->setSymbolBinding("input", &v);
-  auto res = read(envt);
-  return res;
+  StreamSource source{input_stream};
+  Reader reader{source};
+  auto res = reader.next();
+  return res ? res : EmptyList;
 }
 
 }
@@ -2,6 +2,7 @@
 #include <istream>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "value.hpp"
 #include "exception.hpp"
@@ -22,19 +23,110 @@ class ParsingError : public VerboseError {
 
 /***** Classes *****/
 enum class Token {
-  NUMBER, BOOLEAN, CHARACTER, STRING, LPAREN, RPAREN, SYMBOL, QUOTE, BACKTICK, COMMA
+  NUMBER, BOOLEAN, CHARACTER, STRING, LPAREN, RPAREN, SYMBOL, QUOTE, BACKTICK, COMMA,
+  COMMA_AT
+};
+
+// Somewhere the reader can pull more input from.
+class InputSource{
+  public:
+    virtual ~InputSource() = default;
+    // copy up to size bytes into buffer, 0 means the input is exhausted
+    virtual size_t read(char* buffer, size_t size) = 0;
+};
+
+// Reads a line at a time, so interactive input is never read past the
+// line holding the end of the current datum.
+class StreamSource : public InputSource{
+  public:
+    explicit StreamSource(std::istream& stream) : stream_(stream) {}
+    size_t read(char* buffer, size_t size) override;
+  private:
+    std::istream& stream_;
+};
+
+class FileDescriptorSource : public InputSource{
+  public:
+    explicit FileDescriptorSource(int fd) : fd_{fd} {}
+    size_t read(char* buffer, size_t size) override;
+  private:
+    int fd_;
+};
+
+class MemorySource : public InputSource{
+  public:
+    MemorySource(const char* data, size_t size) : data_{data}, size_{size} {}
+    size_t read(char* buffer, size_t size) override;
+  private:
+    const char* data_;
+    size_t size_;
+};
+
+// A whole file mapped into memory, read only, for as long as this lives.
+class MappedFile{
+  public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+  private:
+    const char* data_;
+    size_t size_;
+};
+
+// Pulls input into a buffer, refilling it as needed, and hands out one
+// top level datum at a time. Forms can span any number of lines and
+// refills: the scan for the end of a datum (paren depth, strings, comments,
+// the atom in progress) picks up where it left off after each refill.
+// Input that's already all in memory, like a MappedFile, is read in place
+// instead.
+class Reader{
+  public:
+    explicit Reader(InputSource& source);
+    // the data must outlive the reader and the values it reads
+    Reader(const char* data, size_t size);
+    // the next top level datum, or null once the input is exhausted
+    Value* next();
+
+  private:
+    // scan forward from pos_, true once a whole datum has been seen
+    bool scan();
+    size_t refill();
+
+    InputSource* source_; // null when reading in place
+    std::vector<char> buffer_;
+    const char* input_;   // the buffer, or the data read in place
+    size_t start_; // where the current datum starts
+    size_t pos_;   // how far it's been scanned
+    size_t end_;   // end of the input so far
+    bool started_;
+    long depth_;
+    bool in_atom_;
+    bool in_string_;
+    bool in_comment_;
+    bool escaped_;      // the last character in a string was a backslash
+    bool char_literal_; // the next character belongs to a #\ literal
+    size_t atom_length_;
+};
+
+// A token's text, pointing into the input being read rather than copied
+// out of it.
+struct Span{
+  const char* begin;
+  const char* end;
+  size_t size() const { return end - begin; }
 };
 
 /***** Functions *****/
 Value* doRead(std::istream& input_stream);
-Value* read(Environment* envt);
-std::tuple<Value*, char*> readElement(char* input);
-std::tuple<Value*, char*> readList(char* input, Value* list_so_far);
+Value* read(Value** args, size_t argc);
+// the readers take the input as a range ending at end, which needn't be
+// terminated, and return where they stopped
+std::tuple<Value*, const char*> readElement(const char* input, const char* end);
 bool isDelimiter(char c);
-std::tuple<Token, std::string, char*> readLiteral(char* input);
-std::tuple<Token, std::string, char*> readNumber(char* input, char first_ch);
-std::tuple<Token, std::string, char*> readString(char* input);
-std::tuple<Token, std::string, char*> readSymbol(char* input, char first_ch);
-std::tuple<Token, std::string, char*> readToken(char* input);
+Value* parseInteger(Span digits);
+std::tuple<Token, Span, const char*> readToken(const char* input, const char* end);
 
 }
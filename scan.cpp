@@ -0,0 +1,257 @@
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "scan.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+/***** Scalar *****/
+// Symbols are letters, digits and !$%&*/:<=>?^_~+-@. - anything else stops
+// one, which is also what stops a run of them in the wider scanners below.
+struct StopTable{
+  bool stops[256];
+};
+
+constexpr bool continuesSymbol(int ch){
+  if((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')){
+    return true;
+  }
+  for(const char* c = "!$%&*/:<=>?^_~+-@."; *c; ++c){
+    if(*c == ch){
+      return true;
+    }
+  }
+  return false;
+}
+
+constexpr StopTable makeStopTable(){
+  StopTable table{};
+  for(int ch = 0; ch < 256; ++ch){
+    table.stops[ch] = !continuesSymbol(ch);
+  }
+  return table;
+}
+
+constexpr StopTable AtomStops = makeStopTable();
+
+const char* skipAtomScalar(const char* begin, const char* end){
+  while(begin != end && !AtomStops.stops[static_cast<unsigned char>(*begin)]){
+    ++begin;
+  }
+  return begin;
+}
+
+const char* skipStringBodyScalar(const char* begin, const char* end){
+  while(begin != end && *begin != '"' && *begin != '\\'){
+    ++begin;
+  }
+  return begin;
+}
+
+#if defined(__x86_64__)
+/***** SSE2 *****/
+// SSE2 is part of x86-64, so this level is always there. Bytes are compared
+// as signed, so everything from 0x80 up is below '!' too.
+inline __m128i inRange(__m128i v, char lo, char hi){
+  __m128i clamped = _mm_max_epu8(_mm_min_epu8(v, _mm_set1_epi8(hi)), _mm_set1_epi8(lo));
+  return _mm_cmpeq_epi8(clamped, v);
+}
+
+inline __m128i atomStops(__m128i v){
+  __m128i stops = _mm_or_si128(_mm_cmplt_epi8(v, _mm_set1_epi8('!')),
+                               _mm_cmpeq_epi8(v, _mm_set1_epi8('\x7f')));
+  stops = _mm_or_si128(stops, inRange(v, '"', '#'));
+  stops = _mm_or_si128(stops, inRange(v, '\'', ')'));
+  stops = _mm_or_si128(stops, _mm_cmpeq_epi8(v, _mm_set1_epi8(',')));
+  stops = _mm_or_si128(stops, _mm_cmpeq_epi8(v, _mm_set1_epi8(';')));
+  stops = _mm_or_si128(stops, inRange(v, '[', ']'));
+  stops = _mm_or_si128(stops, _mm_cmpeq_epi8(v, _mm_set1_epi8('`')));
+  return _mm_or_si128(stops, inRange(v, '{', '}'));
+}
+
+const char* skipAtomSSE2(const char* begin, const char* end){
+  for(; end - begin >= 16; begin += 16){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    int mask = _mm_movemask_epi8(atomStops(v));
+    if(mask){
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipAtomScalar(begin, end);
+}
+
+const char* skipStringBodySSE2(const char* begin, const char* end){
+  for(; end - begin >= 16; begin += 16){
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    __m128i stops = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+                                 _mm_cmpeq_epi8(v, _mm_set1_epi8('\\')));
+    int mask = _mm_movemask_epi8(stops);
+    if(mask){
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipStringBodyScalar(begin, end);
+}
+
+/***** AVX2 *****/
+// AVX2 can look bytes up in a 16 entry table, so a byte is classified by
+// its two halves instead: the high nibble picks out a group of rows in the
+// ASCII chart, and the low nibble says which groups stop an atom at that
+// column. Compiled for AVX2 whatever the build's flags and only called once
+// the processor says it has it.
+struct NibbleTables{
+  uint8_t low[16];
+  uint8_t high[16];
+};
+
+constexpr NibbleTables makeNibbleTables(){
+  NibbleTables tables{};
+  // rows that stop an atom at the same columns share a group bit
+  uint8_t next_group = 1;
+  for(int high = 0; high < 16; ++high){
+    uint16_t columns = 0;
+    for(int low = 0; low < 16; ++low){
+      if(AtomStops.stops[high << 4 | low]){
+        columns |= 1 << low;
+      }
+    }
+    if(!columns){
+      continue;
+    }
+    uint8_t group = 0;
+    for(int row = 0; row < high && !group; ++row){
+      uint16_t row_columns = 0;
+      for(int low = 0; low < 16; ++low){
+        if(AtomStops.stops[row << 4 | low]){
+          row_columns |= 1 << low;
+        }
+      }
+      if(row_columns == columns){
+        group = tables.high[row];
+      }
+    }
+    if(!group){
+      group = next_group;
+      next_group <<= 1;
+    }
+    tables.high[high] = group;
+    for(int low = 0; low < 16; ++low){
+      if(columns & (1 << low)){
+        tables.low[low] |= group;
+      }
+    }
+  }
+  return tables;
+}
+
+constexpr NibbleTables AtomNibbles = makeNibbleTables();
+
+__attribute__((target("avx2")))
+inline __m256i atomStops(__m256i v){
+  __m128i low_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(AtomNibbles.low));
+  __m128i high_table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(AtomNibbles.high));
+  __m256i nibble = _mm256_set1_epi8(0x0f);
+  __m256i low = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(low_table),
+                                    _mm256_and_si256(v, nibble));
+  __m256i high = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(high_table),
+                                     _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+  __m256i groups = _mm256_and_si256(low, high);
+  // stops wherever a group matched
+  return _mm256_xor_si256(_mm256_cmpeq_epi8(groups, _mm256_setzero_si256()),
+                          _mm256_set1_epi8(-1));
+}
+
+__attribute__((target("avx2")))
+const char* skipAtomAVX2(const char* begin, const char* end){
+  for(; end - begin >= 32; begin += 32){
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    unsigned mask = _mm256_movemask_epi8(atomStops(v));
+    if(mask){
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipAtomSSE2(begin, end);
+}
+
+__attribute__((target("avx2")))
+const char* skipStringBodyAVX2(const char* begin, const char* end){
+  for(; end - begin >= 32; begin += 32){
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+    __m256i stops = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"')),
+                                    _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\')));
+    unsigned mask = _mm256_movemask_epi8(stops);
+    if(mask){
+      return begin + __builtin_ctz(mask);
+    }
+  }
+  return skipStringBodySSE2(begin, end);
+}
+#endif
+
+/***** Selection *****/
+struct Scanner{
+  ScanLevel level;
+  const char* (*atom)(const char*, const char*);
+  const char* (*string_body)(const char*, const char*);
+};
+
+Scanner scannerFor(ScanLevel level){
+#if defined(__x86_64__)
+  if(level == ScanLevel::AVX2){
+    return Scanner{level, skipAtomAVX2, skipStringBodyAVX2};
+  }
+  if(level == ScanLevel::SSE2){
+    return Scanner{level, skipAtomSSE2, skipStringBodySSE2};
+  }
+#endif
+  return Scanner{ScanLevel::SCALAR, skipAtomScalar, skipStringBodyScalar};
+}
+
+Scanner Current = scannerFor(bestScanLevel());
+
+} // end unnamed namespace
+
+const char* skipAtom(const char* begin, const char* end){
+  return Current.atom(begin, end);
+}
+
+const char* skipStringBody(const char* begin, const char* end){
+  return Current.string_body(begin, end);
+}
+
+ScanLevel scanLevel(){
+  return Current.level;
+}
+
+ScanLevel bestScanLevel(){
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")){
+    return ScanLevel::AVX2;
+  }
+  return ScanLevel::SSE2;
+#else
+  return ScanLevel::SCALAR;
+#endif
+}
+
+void setScanLevel(ScanLevel level){
+  ScanLevel best = bestScanLevel();
+  Current = scannerFor(level > best ? best : level);
+}
+
+const char* scanLevelName(ScanLevel level){
+  switch(level){
+    case ScanLevel::SSE2: return "sse2";
+    case ScanLevel::AVX2: return "avx2";
+    default: return "scalar";
+  }
+}
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+
+namespace crisp{
+
+// How the reader skips over runs of bytes it doesn't need to look at one
+// at a time. The best level the processor supports is picked at startup.
+enum class ScanLevel{
+  SCALAR,
+  SSE2,
+  AVX2
+};
+
+/***** Functions *****/
+// the first byte in [begin, end) that can't continue a symbol (or end)
+const char* skipAtom(const char* begin, const char* end);
+// the first double quote or backslash in [begin, end) (or end)
+const char* skipStringBody(const char* begin, const char* end);
+
+ScanLevel scanLevel();
+ScanLevel bestScanLevel();
+// levels the processor doesn't support fall back to the best one it does
+void setScanLevel(ScanLevel level);
+const char* scanLevelName(ScanLevel level);
+
+}
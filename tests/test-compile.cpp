@@ -0,0 +1,243 @@
+#include "catch.hpp"
+
+#include <algorithm>
+
+#include "value.hpp"
+#include "eval.hpp"
+#include "compile.hpp"
+#include "read.hpp"
+#include "exception.hpp"
+
+using namespace crisp;
+using namespace std;
+
+namespace {
+
+Value* evalString(const string& input){
+  istringstream ss{input};
+  return doEval(doRead(ss));
+}
+
+// body inside enough immediately called lambdas that the locals it refers
+// to are too far out for an operand
+string tooDeep(const string& body){
+  string wrapped = body;
+  for(uint32_t i = 0; i <= MaxDepth; ++i){
+    wrapped = "((lambda () " + wrapped + "))";
+  }
+  return wrapped;
+}
+
+long Iterations = 0;
+
+// a primitive that's true once it's been called Iterations times
+Value* done(Value**, size_t){
+  return --Iterations > 0 ? False : True;
+}
+
+}
+
+TEST_CASE("forms compile to code objects"){
+  initEval();
+  istringstream ss{"(if #t 1 2)"};
+  auto code = compile(doRead(ss), &GlobalEnvironment);
+  REQUIRE(typeOf(code) == Value::Type::CODE);
+  auto& instructions = code->code->instructions;
+  REQUIRE(!instructions.empty());
+  REQUIRE(opcode(instructions.front()) == Opcode::CONST);
+  REQUIRE(opcode(instructions.back()) == Opcode::RETURN);
+}
+
+TEST_CASE("an if without an alternative is unspecified when false"){
+  initEval();
+  auto res = evalString("(if #t 1)");
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 1);
+  REQUIRE(evalString("(if #f 1)") == nullptr);
+  evalString("(define pick (lambda (x) (if x (quote yes))))");
+  REQUIRE(evalString("(pick #t)") == getInternedSymbol("yes"));
+  REQUIRE(evalString("(pick #f)") == nullptr);
+}
+
+TEST_CASE("malformed special forms are errors"){
+  initEval();
+  const char* forms[] = {
+    "(quote)", "(quote a b)", "(lambda)",
+    "(define x)", "(define)", "(define x 1 2)", "(set! x)", "(if)", "(if #t)",
+    "(if #t 1 2 3)", "(let)", "(let x x)", "(let ((x)) x)", "(let ((x 1 2)) x)",
+    "(let (x) x)", "((lambda () (let ((x)) x)))", "((lambda () (define) 1))",
+    "(quasiquote)"
+  };
+  for(auto form : forms){
+    INFO(form);
+    REQUIRE_THROWS_AS(evalString(form), EvaluationError);
+  }
+  // still usable afterwards
+  REQUIRE(fixnumValue(evalString("(let ((x 1)) x)")) == 1);
+}
+
+TEST_CASE("compiled procedures close over their environment"){
+  initEval();
+  evalString("(define make-adder (lambda (n) (lambda (x) (add x n))))");
+  evalString("(define add5 (make-adder 5))");
+  auto res = evalString("(add5 10)");
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 15);
+
+  res = evalString("(let ((x 1) (y 2)) (define z 3) (add x y z))");
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 6);
+}
+
+TEST_CASE("locals are compiled to lexical addresses"){
+  initEval();
+  istringstream ss{"(lambda (x y) (lambda (z) (add x z)))"};
+  auto outer = compile(doRead(ss), &GlobalEnvironment)->code->constants.front();
+  REQUIRE(typeOf(outer) == Value::Type::CODE);
+  REQUIRE(outer->code->locals.size() == 2);
+  auto inner = outer->code->constants.front();
+  REQUIRE(typeOf(inner) == Value::Type::CODE);
+  auto& instructions = inner->code->instructions;
+  REQUIRE(opcode(instructions[0]) == Opcode::GLOBAL_REF);
+  REQUIRE(opcode(instructions[1]) == Opcode::LOCAL_REF);
+  REQUIRE(depth(operand(instructions[1])) == 1);
+  REQUIRE(slot(operand(instructions[1])) == 0);
+  REQUIRE(opcode(instructions[2]) == Opcode::LOCAL_REF);
+  REQUIRE(depth(operand(instructions[2])) == 0);
+  REQUIRE(slot(operand(instructions[2])) == 0);
+}
+
+TEST_CASE("global references cache their bindings"){
+  initEval();
+  evalString("(define caller (lambda () (late 1)))");
+  // nothing is cached while the global is unbound
+  REQUIRE_THROWS_AS(evalString("(caller)"), EvaluationError);
+  evalString("(define late (lambda (x) x))");
+  auto res = evalString("(caller)");
+  REQUIRE(fixnumValue(res) == 1);
+
+  auto caller = GlobalEnvironment.getSymbolBinding("caller")->body->code;
+  auto late = getInternedSymbol("late");
+  auto& constants = caller->constants;
+  auto index = find(begin(constants), end(constants), late) - begin(constants);
+  REQUIRE(caller->cells[index] == GlobalEnvironment.findBinding(late));
+
+  // redefining and setting go through the same binding
+  evalString("(define late (lambda (x) (add x 1)))");
+  REQUIRE(fixnumValue(evalString("(caller)")) == 2);
+  evalString("(set! late (lambda (x) (add x 2)))");
+  REQUIRE(fixnumValue(evalString("(caller)")) == 3);
+}
+
+TEST_CASE("lets inside procedures bind slots in the procedure's frame"){
+  initEval();
+  istringstream ss{"(lambda (x) (let ((y x) (z 2)) (add y z)))"};
+  auto code = compile(doRead(ss), &GlobalEnvironment)->code->constants.front();
+  REQUIRE(code->code->locals.size() == 3);
+  for(auto instruction : code->code->instructions){
+    REQUIRE(opcode(instruction) != Opcode::CLOSURE);
+    REQUIRE(opcode(instruction) != Opcode::CALL);
+  }
+
+  evalString("(define f (lambda (x) (let ((x (add x 1)) (y x)) (define x (add x y)) x)))");
+  REQUIRE(fixnumValue(evalString("(f 1)")) == 3);
+  evalString("(define g (lambda (x) (let ((y 10)) (define x 5) (add x y)) x))");
+  REQUIRE(fixnumValue(evalString("(g 1)")) == 1);
+  evalString("(define h (lambda (x) (add (let ((x 10)) x) (let ((x 20)) x) x)))");
+  REQUIRE(fixnumValue(evalString("(h 1)")) == 31);
+
+  // every call gets its own bindings to close over
+  evalString("(define make (lambda (n) (let ((m n)) (lambda () m))))");
+  evalString("(define one (make 1))");
+  evalString("(define two (make 2))");
+  REQUIRE(fixnumValue(evalString("(one)")) == 1);
+  REQUIRE(fixnumValue(evalString("(two)")) == 2);
+  REQUIRE_THROWS_AS(evalString("((lambda () (let ((a 1) (a 2)) a)))"), EvaluationError);
+}
+
+TEST_CASE("closures share the frames they capture"){
+  initEval();
+  evalString("(define make-counter (lambda (n) (lambda () (set! n (add n 1)) n)))");
+  evalString("(define counter (make-counter 10))");
+  evalString("(define other (make-counter 0))");
+  evalString("(counter)");
+  evalString("(other)");
+  auto res = evalString("(counter)");
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 12);
+}
+
+TEST_CASE("procedures can call themselves"){
+  initEval();
+  evalString("(define countdown (lambda (n) (if n (countdown #f) (quote done))))");
+  auto res = evalString("(countdown #t)");
+  REQUIRE(typeOf(res) == Value::Type::SYMBOL);
+  REQUIRE(res == getInternedSymbol("done"));
+}
+
+TEST_CASE("tail calls run in constant space"){
+  initEval();
+  GlobalEnvironment.setSymbolBinding("done?", new Value(done, 0));
+  Iterations = 300000;
+  evalString("(define loop (lambda (n) (if (done?) n (let ((m (add n 1))) (loop m)))))");
+  auto res = evalString("(loop 0)");
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 299999);
+
+  // frames are reclaimed even when the loop allocates no values
+  auto minor_collections = gc::statistics().minor_collections;
+  Iterations = 300000;
+  evalString("(define spin (lambda () (if (done?) #t (spin))))");
+  res = evalString("(spin)");
+  REQUIRE(res == True);
+  REQUIRE(gc::statistics().minor_collections > minor_collections);
+}
+
+TEST_CASE("errors leave the vm usable"){
+  initEval();
+  REQUIRE_THROWS_AS(evalString("(add 1 (undefined-procedure 2))"), EvaluationError);
+  REQUIRE_THROWS_AS(evalString("((lambda (x) x))"), EvaluationError);
+  REQUIRE_THROWS_AS(evalString("((lambda (x) x) 1 2)"), EvaluationError);
+  // (lambda (x y . xs) (cons (add x y) xs)), since the reader has no dots
+  auto x = getInternedSymbol("x");
+  auto y = getInternedSymbol("y");
+  auto xs = getInternedSymbol("xs");
+  istringstream ss{"(cons (add x y) xs)"};
+  auto lambda = makePair(getInternedSymbol("lambda"),
+                          makePair(makePair(x, makePair(y, xs)),
+                                    makePair(doRead(ss), EmptyList)));
+  GlobalEnvironment.setSymbolBinding("rest-args", doEval(lambda));
+  REQUIRE_THROWS_AS(evalString("(rest-args 1)"), EvaluationError);
+  auto res = evalString("(rest-args 1 2)");
+  REQUIRE(fixnumValue(car(res)) == 3);
+  REQUIRE(cdr(res) == EmptyList);
+  res = evalString("(rest-args 1 2 3 4)");
+  REQUIRE(fixnumValue(car(res)) == 3);
+  REQUIRE(fixnumValue(car(cdr(res))) == 3);
+  REQUIRE(fixnumValue(car(cdr(cdr(res)))) == 4);
+  REQUIRE(cdr(cdr(cdr(res))) == EmptyList);
+  res = evalString("((lambda args args) 1 2)");
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(fixnumValue(car(res)) == 1);
+  REQUIRE(fixnumValue(car(cdr(res))) == 2);
+}
+
+TEST_CASE("locals too far out for an operand still find the right slot"){
+  initEval();
+  // the let's x shares a frame with the parameter it shadows
+  evalString("(define far-shadowed (lambda (x) (let ((x (add x 1))) " + tooDeep("x") + ")))");
+  REQUIRE(fixnumValue(evalString("(far-shadowed 1)")) == 2);
+  // and stops shadowing it once the let is over
+  evalString("(define far-after (lambda (x) (let ((x 10)) x) " + tooDeep("x") + "))");
+  REQUIRE(fixnumValue(evalString("(far-after 1)")) == 1);
+  evalString("(define far-siblings (lambda () (cons (let ((x 1)) " + tooDeep("x") +
+             ") (let ((x 2)) " + tooDeep("x") + "))))");
+  auto res = evalString("(far-siblings)");
+  REQUIRE(fixnumValue(car(res)) == 1);
+  REQUIRE(fixnumValue(cdr(res)) == 2);
+  evalString("(define far-set (lambda (x) (cons (let ((x 1)) " + tooDeep("(set! x 5)") +
+             " x) x)))");
+  res = evalString("(far-set 3)");
+  REQUIRE(fixnumValue(car(res)) == 5);
+  REQUIRE(fixnumValue(cdr(res)) == 3);
+}
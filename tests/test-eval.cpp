@@ -1,8 +1,11 @@
 #include "catch.hpp"
 
+#include <unistd.h>
+
 #include "value.hpp"
 #include "eval.hpp"
 #include "read.hpp"
+#include "gc.hpp"
 
 using namespace crisp;
 using namespace std;
@@ -12,11 +15,11 @@ TEST_CASE("cons builds a pair"){
   initEval();
   auto res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->car->fixnum == 1);
-  REQUIRE(res->cdr->type == Value::Type::FIXNUM);
-  REQUIRE(res->cdr->fixnum == 2);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(res)) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(res)) == 1);
+  REQUIRE(typeOf(cdr(res)) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(cdr(res)) == 2);
 }
 
 TEST_CASE("add is a varadic function doing addition"){
@@ -24,29 +27,29 @@ TEST_CASE("add is a varadic function doing addition"){
   stringstream ss{"add"};
   auto res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PROCEDURE);
+  REQUIRE(typeOf(res) == Value::Type::PROCEDURE);
   REQUIRE(res->is_primitive);
   ss.str(string());
   ss.clear();
   ss << "(add)";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::FIXNUM);
-  REQUIRE(res->fixnum == 0);
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 0);
   ss.str(string());
   ss.clear();
   ss << "(add 1)";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::FIXNUM);
-  REQUIRE(res->fixnum == 1);
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 1);
   ss.str(string());
   ss.clear();
   ss << "(add 1 2 3 4 5)";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::FIXNUM);
-  REQUIRE(res->fixnum == 15);
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 15);
 }
 
 TEST_CASE("add2ormore adds two or more values"){
@@ -54,7 +57,7 @@ TEST_CASE("add2ormore adds two or more values"){
   stringstream ss{"add2ormore"};
   auto res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PROCEDURE);
+  REQUIRE(typeOf(res) == Value::Type::PROCEDURE);
   ss.str(string());
   ss.clear();
   ss << "(add2ormore 1)";
@@ -64,15 +67,15 @@ TEST_CASE("add2ormore adds two or more values"){
   ss << "(add2ormore 1 2)";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::FIXNUM);
-  REQUIRE(res->fixnum == 3);
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 3);
   ss.str(string());
   ss.clear();
   ss << "(add2ormore 1 2 3 4 5)";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::FIXNUM);
-  REQUIRE(res->fixnum == 15);
+  REQUIRE(typeOf(res) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(res) == 15);
 }
 
 TEST_CASE("quasiquote is like quote but only evaluates at runtime"){
@@ -80,40 +83,156 @@ TEST_CASE("quasiquote is like quote but only evaluates at runtime"){
   stringstream ss{"quasiquote"};
   auto res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::SPECIAL_FORM);
+  REQUIRE(typeOf(res) == Value::Type::SPECIAL_FORM);
 
   ss.str(string());
   ss.clear();
   ss << "(quasiquote (1 2 3))";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->car->fixnum == 1);
-  REQUIRE(res->cdr->type == Value::Type::PAIR);
-  REQUIRE(res->cdr->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->cdr->car->fixnum == 2);
-  REQUIRE(res->cdr->cdr->type == Value::Type::PAIR);
-  REQUIRE(res->cdr->cdr->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->cdr->cdr->car->fixnum == 3);
-  REQUIRE(res->cdr->cdr->cdr == EmptyList);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(res)) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(res)) == 1);
+  REQUIRE(typeOf(cdr(res)) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(cdr(res))) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(cdr(res))) == 2);
+  REQUIRE(typeOf(cdr(cdr(res))) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(cdr(cdr(res)))) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(cdr(cdr(res)))) == 3);
+  REQUIRE(cdr(cdr(cdr(res))) == EmptyList);
 
   ss.str(string());
   ss.clear();
   ss << "(quasiquote (9 (unquote (add 1 2))))";
   res = doEval(doRead(ss));
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->car->fixnum == 9);
-  REQUIRE(res->cdr->car->type == Value::Type::FIXNUM);
-  REQUIRE(res->cdr->car->fixnum == 3);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(res)) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(res)) == 9);
+  REQUIRE(typeOf(car(cdr(res))) == Value::Type::FIXNUM);
+  REQUIRE(fixnumValue(car(cdr(res))) == 3);
+}
+
+TEST_CASE("quasiquote only conses around its holes"){
+  initEval();
+  auto printed = [](const string& input){
+    stringstream ss{input};
+    StringPort port;
+    print(doEval(doRead(ss)), port);
+    return port.str();
+  };
+  printed("(define x 5)");
+  printed("(define xs (quote (1 2)))");
+  REQUIRE(printed("`(a (b ,x) c)") == "(a (b 5) c)");
+  REQUIRE(printed("`(,@xs 3 ,@xs)") == "(1 2 3 1 2)");
+  REQUIRE(printed("`(0 ,@xs)") == "(0 1 2)");
+  REQUIRE(printed("`(0 ,@(quote ()) 1)") == "(0 1)");
+  REQUIRE(printed("`(1 unquote x)") == "(1 . 5)");
+  REQUIRE(printed("`(1 `(2 ,(3 ,x)))") == "(1 (quasiquote (2 (unquote (3 5)))))");
+  REQUIRE(printed("`,x") == "5");
+
+  // constant parts of the template are shared, not rebuilt
+  stringstream ss{"`(,x (shared list) 2 3)"};
+  auto tmpl = doRead(ss);
+  auto res = doEval(tmpl);
+  REQUIRE(cdr(res) == cdr(car(cdr(tmpl))));
+  REQUIRE(cdr(doEval(tmpl)) == cdr(res));
+
+  REQUIRE_THROWS_AS(printed("`,@xs"), EvaluationError);
+  REQUIRE_THROWS_AS(printed("`(1 ,@x)"), EvaluationError);
 }
 
 TEST_CASE("symbol bindings added to environment"){
   Environment envt{nullptr};
-  Value dummy;
-  envt.setSymbolBinding("test", &dummy);
-  REQUIRE(envt.getSymbolBinding("test") == &dummy);
+  Value* value = makeFixnum(7);
+  envt.setSymbolBinding("test", value);
+  REQUIRE(envt.getSymbolBinding("test") == value);
+}
+
+
+TEST_CASE("fixnums, characters and booleans are immediates"){
+  initEval();
+  auto evalString = [](const string& input){
+    stringstream ss{input};
+    return doEval(doRead(ss));
+  };
+  evalString("(define count (lambda (n acc) (if (< n 1) acc (count (sub n 1) (add acc n)))))");
+  // compiling and calling cost the same whatever n is, the arithmetic nothing
+  auto allocated = gc::statistics().objects_allocated;
+  REQUIRE(evalString("(count 10 0)") == makeFixnum(55));
+  auto few = gc::statistics().objects_allocated - allocated;
+  allocated = gc::statistics().objects_allocated;
+  REQUIRE(evalString("(count 10000 0)") == makeFixnum(50005000));
+  auto many = gc::statistics().objects_allocated - allocated;
+  REQUIRE(many == few);
+  REQUIRE(makeFixnum(FixnumMax) == makeFixnum(FixnumMax));
+  REQUIRE(fixnumValue(makeFixnum(FixnumMin)) == FixnumMin);
+  REQUIRE(typeOf(makeCharacter('a')) == Value::Type::CHARACTER);
+  REQUIRE(characterValue(makeCharacter('a')) == 'a');
+  REQUIRE(makeBoolean(false) == False);
+  REQUIRE(typeOf(EmptyList) == Value::Type::PAIR);
+  REQUIRE(!gc::isYoung(makeFixnum(3)));
+}
+
+TEST_CASE("a pair is two words"){
+  REQUIRE(sizeof(Pair) == 2 * sizeof(Value*));
+  auto allocated = gc::statistics().bytes_allocated;
+  Value* pair = makePair(makeFixnum(1), EmptyList);
+  auto used = gc::statistics().bytes_allocated - allocated;
+  REQUIRE(used == sizeof(Pair));
+  REQUIRE(typeOf(pair) == Value::Type::PAIR);
+  REQUIRE(fixnumValue(car(pair)) == 1);
+  REQUIRE(cdr(pair) == EmptyList);
+}
+
+TEST_CASE("primitives check their declared arity"){
+  initEval();
+  stringstream ss{"(cons 1)"};
+  REQUIRE_THROWS_AS(doEval(doRead(ss)), EvaluationError);
+  ss.str("(cons 1 2 3)");
+  ss.clear();
+  REQUIRE_THROWS_AS(doEval(doRead(ss)), EvaluationError);
+  ss.str("(cons (quote a) (quote b))");
+  ss.clear();
+  auto res = doEval(doRead(ss));
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(car(res) == getInternedSymbol("a"));
+  REQUIRE(cdr(res) == getInternedSymbol("b"));
+}
+
+TEST_CASE("arithmetic, comparison and list primitives"){
+  initEval();
+  auto evalString = [](const string& input){
+    stringstream ss{input};
+    return doEval(doRead(ss));
+  };
+  REQUIRE(fixnumValue(evalString("(sub 10 3 2)")) == 5);
+  REQUIRE(fixnumValue(evalString("(sub 4)")) == -4);
+  REQUIRE(fixnumValue(evalString("(mul 2 3 4)")) == 24);
+  REQUIRE(evalString("(< 1 2 3)") == True);
+  REQUIRE(evalString("(< 1 3 2)") == False);
+  REQUIRE(evalString("(= 2 2)") == True);
+  REQUIRE(fixnumValue(evalString("(car (cons 1 2))")) == 1);
+  REQUIRE(fixnumValue(evalString("(cdr (cons 1 2))")) == 2);
+  REQUIRE(evalString("(null? (quote ()))") == True);
+  REQUIRE(evalString("(eq? (quote a) (quote a))") == True);
+  REQUIRE_THROWS_AS(evalString("(car (quote ()))"), EvaluationError);
 }
 
+TEST_CASE("load evaluates every form in a file"){
+  initEval();
+  char path[] = "/tmp/crisp-load-XXXXXX";
+  int fd = mkstemp(path);
+  REQUIRE(fd >= 0);
+  string contents = "; a comment\n(define loaded-x 40)\n(define loaded-y\n  (add loaded-x 2))\nloaded-y";
+  REQUIRE(write(fd, contents.data(), contents.size()) == static_cast<ssize_t>(contents.size()));
+  close(fd);
+
+  istringstream ss{"(load \"" + string(path) + "\")"};
+  auto res = doEval(doRead(ss));
+  REQUIRE(fixnumValue(res) == 42);
+  REQUIRE(fixnumValue(GlobalEnvironment.getSymbolBinding("loaded-x")) == 40);
+  unlink(path);
+
+  REQUIRE_THROWS_AS(loadFile(path), ParsingError);
+}
@@ -0,0 +1,284 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "value.hpp"
+#include "compile.hpp"
+#include "eval.hpp"
+#include "fasl.hpp"
+#include "image.hpp"
+#include "number.hpp"
+#include "read.hpp"
+
+using namespace crisp;
+using namespace std;
+
+namespace {
+
+Value* parse(const string& input){
+  istringstream ss{input};
+  return doRead(ss);
+}
+
+// value written out to a file that's then loaded
+Value* written(Value* value){
+  char path[] = "/tmp/crisp-fasl-XXXXXX";
+  close(mkstemp(path));
+  faslWriteFile(path, value);
+  try{
+    Value* res = loadFile(path);
+    unlink(path);
+    return res;
+  } catch(...){
+    unlink(path);
+    throw;
+  }
+}
+
+}
+
+TEST_CASE("values survive a round trip through fasl"){
+  initEval();
+  Value* shared = parse("(\"shared\" -5)");
+  Value* value = makePair(shared, makePair(shared, parse("(sym 100000 #\\a #t -99999999999 sym)")));
+  ostringstream output;
+  FaslWriter writer{output};
+  writer.write(value);
+  writer.write(getInternedSymbol("sym"));
+  string data = output.str();
+
+  FaslReader reader{data.data(), data.size()};
+  Value* res = reader.next();
+  REQUIRE(car(res) == car(cdr(res)));
+  REQUIRE(strcmp(car(car(res))->str.str, "shared") == 0);
+  REQUIRE(fixnumValue(car(cdr(car(res)))) == -5);
+  Value* rest = cdr(cdr(res));
+  REQUIRE(car(rest) == getInternedSymbol("sym"));
+  REQUIRE(fixnumValue(car(cdr(rest))) == 100000);
+  REQUIRE(characterValue(car(cdr(cdr(rest)))) == 'a');
+  REQUIRE(car(cdr(cdr(cdr(rest)))) == True);
+  REQUIRE(fixnumValue(car(cdr(cdr(cdr(cdr(rest)))))) == -99999999999);
+  REQUIRE(car(cdr(cdr(cdr(cdr(cdr(rest)))))) == getInternedSymbol("sym"));
+  REQUIRE(reader.next() == getInternedSymbol("sym"));
+  REQUIRE(reader.next() == nullptr);
+
+  ostringstream big_output;
+  FaslWriter big_writer{big_output};
+  big_writer.write(parse("(-123456789012345678901234567890 18446744073709551616)"));
+  string big_data = big_output.str();
+  FaslReader big_reader{big_data.data(), big_data.size()};
+  Value* big = big_reader.next();
+  REQUIRE(typeOf(car(big)) == Value::Type::BIGNUM);
+  REQUIRE(car(big)->bignum->toDecimal() == "-123456789012345678901234567890");
+  REQUIRE(car(cdr(big))->bignum->toDecimal() == "18446744073709551616");
+
+  REQUIRE_THROWS_AS(FaslReader("(not fasl)", 10), FaslError);
+  FaslReader truncated{data.data(), data.size() / 2};
+  REQUIRE_THROWS_AS(truncated.next(), FaslError);
+}
+
+TEST_CASE("labels don't carry over from one value to the next"){
+  initEval();
+  Value* shared = parse("(1 2)");
+  Value* value = makePair(shared, makePair(shared, EmptyList));
+  ostringstream output;
+  FaslWriter writer{output};
+  writer.write(value);
+  writer.write(value);
+  string data = output.str();
+
+  FaslReader reader{data.data(), data.size()};
+  Value* first = reader.next();
+  Value* second = reader.next();
+  REQUIRE(first != second);
+  REQUIRE(car(second) == car(cdr(second)));
+  REQUIRE(fixnumValue(car(cdr(car(second)))) == 2);
+  REQUIRE(reader.next() == nullptr);
+}
+
+TEST_CASE("compiled files load without being read"){
+  initEval();
+  char source[] = "/tmp/crisp-source-XXXXXX";
+  char compiled[] = "/tmp/crisp-fasl-XXXXXX";
+  close(mkstemp(source));
+  close(mkstemp(compiled));
+  {
+    ofstream output{source};
+    output << "(define fasl-square (lambda (x) (mul x x)))\n"
+              "(define fasl-list (quote (a \"b\" 3)))\n"
+              "(define fasl-rest (lambda xs xs))\n"
+              "(fasl-square 12)\n";
+  }
+  compileFile(source, compiled);
+  auto res = loadFile(compiled);
+  REQUIRE(fixnumValue(res) == 144);
+  istringstream rest{"(fasl-rest 1 2 3)"};
+  REQUIRE(fixnumValue(car(cdr(cdr(doEval(doRead(rest)))))) == 3);
+  REQUIRE(fixnumValue(car(cdr(cdr(GlobalEnvironment.getSymbolBinding("fasl-list"))))) == 3);
+  unlink(source);
+  unlink(compiled);
+}
+
+TEST_CASE("damaged code doesn't load"){
+  initEval();
+  // the top level code makes a closure over the code for the lambda
+  auto damaged = [](function<void(Code* top, Code* lambda)> damage){
+    Value* top = compile(parse("(define fasl-sq (lambda (x) (mul x x)))"), &GlobalEnvironment);
+    auto closure = find_if(begin(top->code->constants), end(top->code->constants),
+                           [](Value* c){ return typeOf(c) == Value::Type::CODE; });
+    damage(top->code, (*closure)->code);
+    return top;
+  };
+
+  REQUIRE(written(damaged([](Code*, Code*){})) == nullptr);
+  REQUIRE(fixnumValue(doEval(parse("(fasl-sq 12)"))) == 144);
+
+  // an opcode with no handler
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions[0] = OpcodeCount;
+  })), FaslError);
+  // a constant that isn't there
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions[0] = encode(Opcode::GLOBAL_REF, lambda->constants.size());
+  })), FaslError);
+  // a closure over something that isn't code
+  REQUIRE_THROWS_AS(written(damaged([](Code* top, Code*){
+    auto symbol = find_if(begin(top->constants), end(top->constants),
+                          [](Value* c){ return typeOf(c) == Value::Type::SYMBOL; });
+    for(auto& instruction : top->instructions){
+      if(opcode(instruction) == Opcode::CLOSURE){
+        instruction = encode(Opcode::CLOSURE, symbol - begin(top->constants));
+      }
+    }
+  })), FaslError);
+  // a jump off the end
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions.insert(begin(lambda->instructions),
+                                encode(Opcode::JUMP, lambda->instructions.size() + 1));
+  })), FaslError);
+  // running off the end
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions.pop_back();
+  })), FaslError);
+  // a slot past the end of the frame, and a frame that isn't there
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions[1] = encode(Opcode::LOCAL_REF, address(0, 1));
+  })), FaslError);
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    lambda->instructions[1] = encode(Opcode::LOCAL_REF, address(1, 0));
+  })), FaslError);
+  // calling with more arguments than are on the stack
+  REQUIRE_THROWS_AS(written(damaged([](Code*, Code* lambda){
+    for(auto& instruction : lambda->instructions){
+      if(opcode(instruction) == Opcode::TAIL_CALL){
+        instruction = encode(Opcode::TAIL_CALL, 3);
+      }
+    }
+  })), FaslError);
+}
+
+TEST_CASE("far addresses load and are checked"){
+  initEval();
+  string body = "x";
+  for(uint32_t i = 0; i <= MaxDepth; ++i){
+    body = "((lambda () " + body + "))";
+  }
+  string source = "(define fasl-far (lambda (x) " + body + "))";
+  REQUIRE(written(compile(parse(source), &GlobalEnvironment)) == nullptr);
+  REQUIRE(fixnumValue(doEval(parse("(fasl-far 7)"))) == 7);
+
+  // the innermost lambda, the only code with a FAR_REF
+  auto far = [&](Value* address){
+    Value* top = compile(parse(source), &GlobalEnvironment);
+    Code* code = top->code;
+    for(bool found = false; !found;){
+      auto closure = find_if(begin(code->constants), end(code->constants),
+                             [](Value* c){ return typeOf(c) == Value::Type::CODE; });
+      code = (*closure)->code;
+      for(auto& instruction : code->instructions){
+        if(opcode(instruction) == Opcode::FAR_REF){
+          code->constants[operand(instruction)] = address;
+          found = true;
+        }
+      }
+    }
+    return top;
+  };
+  REQUIRE(written(far(makeFixnum(farAddress(MaxDepth + 1, 0)))) == nullptr);
+  REQUIRE_THROWS_AS(written(far(makeFixnum(farAddress(MaxDepth + 1, 1)))), FaslError);
+  REQUIRE_THROWS_AS(written(far(makeFixnum(farAddress(MaxDepth + 2, 0)))), FaslError);
+  REQUIRE_THROWS_AS(written(far(makeFixnum(-1))), FaslError);
+  REQUIRE_THROWS_AS(written(far(getInternedSymbol("x"))), FaslError);
+}
+
+TEST_CASE("top level code can't also be a procedure body"){
+  initEval();
+  // the body refers to its argument, which top level code doesn't have
+  doEval(parse("(define fasl-self (lambda (x) x))"));
+  Value* procedure = GlobalEnvironment.getBinding(getInternedSymbol("fasl-self"));
+  Code* body = procedure->body->code;
+  body->constants.push_back(procedure);
+  body->cells.resize(body->constants.size());
+  REQUIRE_THROWS_AS(written(procedure->body), FaslError);
+}
+
+TEST_CASE("heap images keep closures and their environments"){
+  initEval();
+  char image[] = "/tmp/crisp-image-XXXXXX";
+  close(mkstemp(image));
+  istringstream definitions{
+    "(define image-counter ((lambda (n) (lambda () (set! n (add n 1)) n)) 10))"};
+  doEval(doRead(definitions));
+  istringstream call{"(image-counter)"};
+  doEval(doRead(call));
+  dumpImage(image);
+
+  // clobber what the image saved, then boot it back
+  GlobalEnvironment.setSymbolBinding("image-counter", EmptyList);
+  GlobalEnvironment.setSymbolBinding("cons", EmptyList);
+  bootImage(image);
+  istringstream again{"(cons (image-counter) (image-counter))"};
+  auto res = doEval(doRead(again));
+  REQUIRE(fixnumValue(car(res)) == 12);
+  REQUIRE(fixnumValue(cdr(res)) == 13);
+  unlink(image);
+}
+
+TEST_CASE("images with bad bindings don't boot"){
+  initEval();
+  char image[] = "/tmp/crisp-image-XXXXXX";
+  close(mkstemp(image));
+  // an image header followed by bindings, or nothing if null
+  auto booted = [&](Value* bindings){
+    {
+      ofstream output{image, ios::binary};
+      FaslWriter writer{output};
+      writer.write(makePair(getInternedSymbol("crisp-image"), EmptyList));
+      if(bindings){
+        writer.write(bindings);
+      }
+    }
+    bootImage(image);
+  };
+  Value* symbol = getInternedSymbol("image-bad");
+  Value* good = makePair(makePair(symbol, makeFixnum(1)), EmptyList);
+  booted(good);
+  REQUIRE(GlobalEnvironment.getBinding(symbol) == makeFixnum(1));
+
+  REQUIRE_THROWS_AS(booted(nullptr), FaslError);
+  REQUIRE_THROWS_AS(booted(makeFixnum(5)), FaslError);
+  REQUIRE_THROWS_AS(booted(makePair(makeFixnum(5), EmptyList)), FaslError);
+  REQUIRE_THROWS_AS(booted(makePair(EmptyList, EmptyList)), FaslError);
+  REQUIRE_THROWS_AS(booted(makePair(makePair(makeFixnum(1), makeFixnum(2)), EmptyList)),
+                    FaslError);
+  // improper, and nothing bound from the good part before it
+  REQUIRE_THROWS_AS(booted(makePair(makePair(symbol, makeFixnum(2)), makeFixnum(3))),
+                    FaslError);
+  REQUIRE(GlobalEnvironment.getBinding(symbol) == makeFixnum(1));
+  unlink(image);
+}
@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include "value.hpp"
+#include "eval.hpp"
+#include "read.hpp"
+#include "gc.hpp"
+
+using namespace crisp;
+using namespace std;
+
+TEST_CASE("collection keeps reachable values"){
+  initEval();
+  stringstream ss{"(define kept (cons 1 2))"};
+  doEval(doRead(ss));
+  gc::collect();
+  ss.str(string());
+  ss.clear();
+  ss << "kept";
+  auto res = doEval(doRead(ss));
+  REQUIRE(res != nullptr);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(fixnumValue(car(res)) == 1);
+  REQUIRE(fixnumValue(cdr(res)) == 2);
+}
+
+TEST_CASE("rooted locals survive a collection"){
+  Value* pair = makePair(makeFixnum(1), makeFixnum(2));
+  gc::Root pair_root{pair};
+  gc::collect();
+  REQUIRE(typeOf(pair) == Value::Type::PAIR);
+  REQUIRE(fixnumValue(car(pair)) == 1);
+  REQUIRE(fixnumValue(cdr(pair)) == 2);
+}
+
+TEST_CASE("surviving values are promoted out of the nursery"){
+  Value* pair = makePair(makePair(makeFixnum(1), EmptyList), makeFixnum(2));
+  gc::Root pair_root{pair};
+  REQUIRE(gc::isYoung(pair));
+  REQUIRE(gc::isYoung(car(pair)));
+  REQUIRE(!gc::isYoung(cdr(pair)));
+  gc::collectNursery();
+  REQUIRE(!gc::isYoung(pair));
+  REQUIRE(!gc::isYoung(car(pair)));
+  REQUIRE(fixnumValue(car(car(pair))) == 1);
+  REQUIRE(cdr(car(pair)) == EmptyList);
+  REQUIRE(fixnumValue(cdr(pair)) == 2);
+}
+
+TEST_CASE("old environments pointing into the nursery are remembered"){
+  initEval();
+  gc::collectNursery();
+  stringstream ss{"(define young (cons 3 4))"};
+  doEval(doRead(ss));
+  gc::collectNursery();
+  ss.str(string());
+  ss.clear();
+  ss << "young";
+  auto res = doEval(doRead(ss));
+  REQUIRE(fixnumValue(car(res)) == 3);
+  REQUIRE(fixnumValue(cdr(res)) == 4);
+}
+
+TEST_CASE("heap stays flat under sustained evaluation"){
+  initEval();
+  gc::collect();
+  auto minor_collections = gc::statistics().minor_collections;
+  auto promoted = gc::statistics().bytes_promoted;
+  auto allocated = gc::statistics().bytes_allocated;
+  auto threshold = gc::statistics().threshold;
+  gc::setThreshold(1 << 16);
+  size_t heap_size = 0;
+  for(int i = 0; i < 20000; ++i){
+    stringstream ss{"((lambda (x y) (cons x (add x y))) 3 4)"};
+    doEval(doRead(ss));
+    if(i == 1000){
+      heap_size = gc::statistics().heap_size;
+    }
+  }
+  REQUIRE(gc::statistics().minor_collections > minor_collections);
+  REQUIRE(gc::statistics().heap_size <= heap_size);
+  // nearly everything dies young
+  promoted = gc::statistics().bytes_promoted - promoted;
+  allocated = gc::statistics().bytes_allocated - allocated;
+  REQUIRE(allocated > promoted * 100);
+  gc::setThreshold(threshold);
+}
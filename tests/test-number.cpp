@@ -0,0 +1,119 @@
+#include "catch.hpp"
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "value.hpp"
+#include "eval.hpp"
+#include "number.hpp"
+#include "port.hpp"
+#include "read.hpp"
+
+using namespace crisp;
+using namespace std;
+
+namespace {
+
+Bignum decimal(const string& digits){
+  return Bignum::fromDecimal(digits.data(), digits.data() + digits.size());
+}
+
+Value* evalString(const string& input){
+  istringstream ss{input};
+  return doEval(doRead(ss));
+}
+
+string printed(const string& input){
+  StringPort port;
+  print(evalString(input), port);
+  return port.str();
+}
+
+}
+
+TEST_CASE("bignums convert to and from decimal"){
+  REQUIRE(Bignum{}.toDecimal() == "0");
+  REQUIRE(Bignum{numeric_limits<long>::min()}.toDecimal() == to_string(numeric_limits<long>::min()));
+  string digits = "-1234567890123456789012345678901234567890000000001";
+  REQUIRE(decimal(digits).toDecimal() == digits);
+  REQUIRE(decimal("-0").toDecimal() == "0");
+  REQUIRE(decimal("000123").toDecimal() == "123");
+  REQUIRE(decimal("4611686018427387903").fitsFixnum());
+  REQUIRE(decimal("-4611686018427387904").fitsFixnum());
+  REQUIRE(!decimal("4611686018427387904").fitsFixnum());
+  REQUIRE(!decimal("9223372036854775807").fitsFixnum());
+  REQUIRE(decimal("-4611686018427387904").toFixnum() == FixnumMin);
+}
+
+TEST_CASE("bignum arithmetic carries and borrows across limbs"){
+  auto big = decimal("340282366920938463463374607431768211456"); // 2^128
+  REQUIRE((big - Bignum{1}).toDecimal() == "340282366920938463463374607431768211455");
+  REQUIRE((Bignum{1} - big).toDecimal() == "-340282366920938463463374607431768211455");
+  REQUIRE((big + -big).isZero());
+  REQUIRE((big * big).toDecimal() ==
+          "115792089237316195423570985008687907853269984665640564039457584007913129639936");
+  REQUIRE((big * -Bignum{3}).toDecimal() == "-1020847100762815390390123822295304634368");
+  REQUIRE(big.compare(-big) > 0);
+  REQUIRE((-big).compare(Bignum{-1}) < 0);
+  REQUIRE(big.compare(decimal("340282366920938463463374607431768211456")) == 0);
+}
+
+TEST_CASE("large products agree with the schoolbook identities"){
+  // (10^k - 1)^2 = 10^2k - 2 10^k + 1, which is k-1 nines, an 8, k-1
+  // zeros and a 1; big enough to go through Karatsuba
+  const size_t k = 3000;
+  auto nines = decimal(string(k, '9'));
+  auto square = nines * nines;
+  REQUIRE(square.toDecimal() == string(k - 1, '9') + "8" + string(k - 1, '0') + "1");
+
+  // operands of very different lengths split only the longer one
+  auto short_nines = decimal(string(400, '9'));
+  REQUIRE((nines * short_nines).compare(short_nines * nines) == 0);
+  REQUIRE((nines * short_nines).toDecimal() ==
+          string(399, '9') + "8" + string(k - 400, '9') + string(399, '0') + "1");
+
+  // (a + b)^2 = a^2 + 2ab + b^2
+  auto a = decimal(string(1500, '7') + "12345");
+  auto b = decimal("-" + string(900, '3') + "98765");
+  REQUIRE(((a + b) * (a + b)).compare(a * a + Bignum{2} * a * b + b * b) == 0);
+}
+
+TEST_CASE("tagged fixnum arithmetic stops at the edges of the range"){
+  REQUIRE(addIntegers(makeFixnum(-7), makeFixnum(3)) == makeFixnum(-4));
+  REQUIRE(subtractIntegers(makeFixnum(-7), makeFixnum(3)) == makeFixnum(-10));
+  REQUIRE(multiplyIntegers(makeFixnum(-7), makeFixnum(3)) == makeFixnum(-21));
+  REQUIRE(compareIntegers(makeFixnum(-7), makeFixnum(3)) < 0);
+  REQUIRE(addIntegers(makeFixnum(FixnumMax), makeFixnum(0)) == makeFixnum(FixnumMax));
+  REQUIRE(typeOf(addIntegers(makeFixnum(FixnumMax), makeFixnum(1))) == Value::Type::BIGNUM);
+  REQUIRE(typeOf(subtractIntegers(makeFixnum(FixnumMin), makeFixnum(1))) == Value::Type::BIGNUM);
+  REQUIRE(typeOf(multiplyIntegers(makeFixnum(FixnumMax), makeFixnum(2))) == Value::Type::BIGNUM);
+  REQUIRE(multiplyIntegers(makeFixnum(FixnumMin), makeFixnum(1)) == makeFixnum(FixnumMin));
+  REQUIRE(compareIntegers(makeFixnum(FixnumMin), makeFixnum(FixnumMax)) < 0);
+}
+
+TEST_CASE("fixnum arithmetic overflows into bignums"){
+  initEval();
+  REQUIRE(printed("(add 9223372036854775807 1)") == "9223372036854775808");
+  REQUIRE(printed("(add 9223372036854775807 1 -1)") == "9223372036854775807");
+  REQUIRE(typeOf(evalString("(add 9223372036854775807 1 -1)")) == Value::Type::BIGNUM);
+  REQUIRE(printed("(add 4611686018427387903 1)") == "4611686018427387904");
+  REQUIRE(typeOf(evalString("(add 4611686018427387903 1 -1)")) == Value::Type::FIXNUM);
+  REQUIRE(printed("(sub -4611686018427387904 1)") == "-4611686018427387905");
+  REQUIRE(printed("(mul 2147483648 2147483648)") == "4611686018427387904");
+  REQUIRE(typeOf(evalString("(mul -2147483648 2147483648)")) == Value::Type::FIXNUM);
+  REQUIRE(printed("(sub -9223372036854775808)") == "9223372036854775808");
+  REQUIRE(printed("(sub -9223372036854775808 1)") == "-9223372036854775809");
+  REQUIRE(printed("(sub 100000000000000000000 1)") == "99999999999999999999");
+  REQUIRE(printed("(mul 4294967296 4294967296 4294967296)") == "79228162514264337593543950336");
+  REQUIRE(printed("(mul 100000000000000000000 0)") == "0");
+  REQUIRE(printed("(addxy 9223372036854775807 9223372036854775807)") == "18446744073709551614");
+  REQUIRE(printed("(addxy 4611686018427387903 4611686018427387903)") == "9223372036854775806");
+  REQUIRE(printed("(addxy -4611686018427387904 -1)") == "-4611686018427387905");
+  REQUIRE(printed("(sub -4611686018427387904)") == "4611686018427387904");
+  REQUIRE(printed("(< 1 100000000000000000000 200000000000000000000)") == "True");
+  REQUIRE(printed("(< -100000000000000000000 -5)") == "True");
+  REQUIRE(printed("(= 100000000000000000000 100000000000000000000)") == "True");
+  REQUIRE(printed("(= 100000000000000000000 1)") == "False");
+  REQUIRE_THROWS_AS(printed("(add 100000000000000000000 #t)"), EvaluationError);
+}
@@ -0,0 +1,62 @@
+#include "catch.hpp"
+
+#include <limits>
+#include <sstream>
+#include <string>
+
+#include "value.hpp"
+#include "eval.hpp"
+#include "port.hpp"
+#include "read.hpp"
+
+using namespace crisp;
+using namespace std;
+
+namespace {
+
+string printed(const string& input){
+  initEval();
+  istringstream ss{input};
+  StringPort port;
+  print(doRead(ss), port);
+  return port.str();
+}
+
+}
+
+TEST_CASE("print writes each kind of value to a port"){
+  REQUIRE(printed("()") == "()");
+  REQUIRE(printed("-42") == "-42");
+  REQUIRE(printed("#t") == "True");
+  REQUIRE(printed("#\\a") == "#\\a");
+  REQUIRE(printed("\"hi there\"") == "\"hi there\"");
+  REQUIRE(printed("sym") == "sym");
+  REQUIRE(printed("(1 (2 3) \"x\")") == "(1 (2 3) \"x\")");
+  StringPort port;
+  print(makePair(makeFixnum(1), makePair(makeFixnum(2), makeFixnum(3))), port);
+  REQUIRE(port.str() == "(1 2 . 3)");
+}
+
+TEST_CASE("fixnums print at the edges of their range"){
+  StringPort port;
+  port.writeFixnum(0);
+  port.put(' ');
+  port.writeFixnum(numeric_limits<long>::max());
+  port.put(' ');
+  port.writeFixnum(numeric_limits<long>::min());
+  REQUIRE(port.str() == "0 " + to_string(numeric_limits<long>::max()) + " " +
+                        to_string(numeric_limits<long>::min()));
+}
+
+TEST_CASE("string ports hold output bigger than their buffer"){
+  StringPort port;
+  string big(10000, 'x');
+  for(int i = 0; i < 1000; ++i){
+    port.put('a');
+  }
+  port.write(big);
+  port.write("b");
+  REQUIRE(port.str() == string(1000, 'a') + big + "b");
+  port.clear();
+  REQUIRE(port.str().empty());
+}
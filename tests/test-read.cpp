@@ -2,6 +2,7 @@
 
 #include "value.hpp"
 #include "read.hpp"
+#include "scan.hpp"
 #include "eval.hpp"
 
 using namespace std;
@@ -11,38 +12,219 @@ TEST_CASE("single quote expands to quote"){
   istringstream ss{"'input"};
   auto res = doRead(ss);
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car != nullptr);
-  REQUIRE(res->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->car->symbol.name, "quote") == 0);
-  REQUIRE(res->cdr->type == Value::Type::PAIR);
-  REQUIRE(res->cdr->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->cdr->car->symbol.name, "input") == 0);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(car(res) != nullptr);
+  REQUIRE(typeOf(car(res)) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(res)->symbol.name, "quote") == 0);
+  REQUIRE(typeOf(cdr(res)) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(cdr(res))) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(cdr(res))->symbol.name, "input") == 0);
 }
 
 TEST_CASE("backtick expands to quasiquote"){
   istringstream ss{"`input"};
   auto res = doRead(ss);
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car != nullptr);
-  REQUIRE(res->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->car->symbol.name, "quasiquote") == 0);
-  REQUIRE(res->cdr->type == Value::Type::PAIR);
-  REQUIRE(res->cdr->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->cdr->car->symbol.name, "input") == 0);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(car(res) != nullptr);
+  REQUIRE(typeOf(car(res)) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(res)->symbol.name, "quasiquote") == 0);
+  REQUIRE(typeOf(cdr(res)) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(cdr(res))) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(cdr(res))->symbol.name, "input") == 0);
+}
+
+TEST_CASE("comma at expands to unquote-splicing"){
+  istringstream ss{"(,@input ,x)"};
+  auto res = doRead(ss);
+  REQUIRE(res != nullptr);
+  REQUIRE(typeOf(car(res)) == Value::Type::PAIR);
+  REQUIRE(car(car(res)) == getInternedSymbol("unquote-splicing"));
+  REQUIRE(car(cdr(car(res))) == getInternedSymbol("input"));
+  REQUIRE(car(car(cdr(res))) == getInternedSymbol("unquote"));
+  REQUIRE(car(cdr(car(cdr(res)))) == getInternedSymbol("x"));
+  istringstream symbol{"a@b"};
+  REQUIRE(doRead(symbol) == getInternedSymbol("a@b"));
 }
 
 TEST_CASE("comma expands to unquote"){
   istringstream ss{",input"};
   auto res = doRead(ss);
   REQUIRE(res != nullptr);
-  REQUIRE(res->type == Value::Type::PAIR);
-  REQUIRE(res->car != nullptr);
-  REQUIRE(res->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->car->symbol.name, "unquote") == 0);
-  REQUIRE(res->cdr->type == Value::Type::PAIR);
-  REQUIRE(res->cdr->car->type == Value::Type::SYMBOL);
-  REQUIRE(strcmp(res->cdr->car->symbol.name, "input") == 0);
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(car(res) != nullptr);
+  REQUIRE(typeOf(car(res)) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(res)->symbol.name, "unquote") == 0);
+  REQUIRE(typeOf(cdr(res)) == Value::Type::PAIR);
+  REQUIRE(typeOf(car(cdr(res))) == Value::Type::SYMBOL);
+  REQUIRE(strcmp(car(cdr(res))->symbol.name, "input") == 0);
+}
+
+
+TEST_CASE("symbols with the same name are interned once"){
+  istringstream ss{"(some-symbol some-symbol some-symbol-2)"};
+  auto res = doRead(ss);
+  REQUIRE(car(res) == car(cdr(res)));
+  REQUIRE(car(res) != car(cdr(cdr(res))));
+  REQUIRE(car(res) == getInternedSymbol("some-symbol"));
+  REQUIRE(car(res)->symbol.length == strlen("some-symbol"));
+
+  auto before = internStatistics();
+  for(int i = 0; i < 1000; ++i){
+    getInternedSymbol("generated-symbol-" + to_string(i));
+  }
+  auto after = internStatistics();
+  REQUIRE(after.symbols == before.symbols + 1000);
+  REQUIRE(after.lookups == before.lookups + 1000);
+  REQUIRE(after.buckets >= 2 * after.symbols);
+  REQUIRE(getInternedSymbol("generated-symbol-500") == getInternedSymbol("generated-symbol-500"));
+}
+
+namespace {
+
+// hands out its input a few bytes at a time to exercise refilling
+class TrickleSource : public InputSource{
+  public:
+    TrickleSource(const string& data) : data_{data}, pos_{0} {}
+    size_t read(char* buffer, size_t size) override {
+      size_t count = min(min(size, size_t{3}), data_.size() - pos_);
+      memcpy(buffer, data_.data() + pos_, count);
+      pos_ += count;
+      return count;
+    }
+  private:
+    string data_;
+    size_t pos_;
+};
+
+}
+
+TEST_CASE("the reader yields datums spanning lines and refills"){
+  TrickleSource source{"(define x\n  ; a comment\n  (cons 1\n        \"a ) string\"))\nsymbol 42\n'(quoted\n list)  "};
+  Reader reader{source};
+  auto res = reader.next();
+  REQUIRE(typeOf(res) == Value::Type::PAIR);
+  REQUIRE(car(res) == getInternedSymbol("define"));
+  auto value = car(cdr(cdr(res)));
+  REQUIRE(car(value) == getInternedSymbol("cons"));
+  REQUIRE(fixnumValue(car(cdr(value))) == 1);
+  REQUIRE(strcmp(car(cdr(cdr(value)))->str.str, "a ) string") == 0);
+  REQUIRE(reader.next() == getInternedSymbol("symbol"));
+  REQUIRE(fixnumValue(reader.next()) == 42);
+  res = reader.next();
+  REQUIRE(car(res) == getInternedSymbol("quote"));
+  REQUIRE(car(cdr(car(cdr(res)))) == getInternedSymbol("list"));
+  REQUIRE(reader.next() == nullptr);
+}
+
+TEST_CASE("the reader keeps a comma at prefix with its datum"){
+  TrickleSource source{",@(a b) c"};
+  Reader reader{source};
+  auto res = reader.next();
+  REQUIRE(car(res) == getInternedSymbol("unquote-splicing"));
+  REQUIRE(car(car(cdr(res))) == getInternedSymbol("a"));
+  REQUIRE(reader.next() == getInternedSymbol("c"));
+  REQUIRE(reader.next() == nullptr);
 }
 
+TEST_CASE("the reader rejects unbalanced input"){
+  MemorySource unclosed{"(a (b c)", 8};
+  Reader reader{unclosed};
+  REQUIRE_THROWS_AS(reader.next(), ParsingError);
+
+  MemorySource extra{") a", 3};
+  Reader other{extra};
+  REQUIRE_THROWS_AS(other.next(), ParsingError);
+  REQUIRE(other.next() == getInternedSymbol("a"));
+}
+
+TEST_CASE("tokens are read without copying them out"){
+  istringstream ss{"(-42 - #\\a \"str\" sym #f)"};
+  auto res = doRead(ss);
+  REQUIRE(fixnumValue(car(res)) == -42);
+  REQUIRE(car(cdr(res)) == getInternedSymbol("-"));
+  REQUIRE(characterValue(car(cdr(cdr(res)))) == 'a');
+  REQUIRE(strcmp(car(cdr(cdr(cdr(res))))->str.str, "str") == 0);
+  REQUIRE(car(cdr(cdr(cdr(cdr(res))))) == getInternedSymbol("sym"));
+  REQUIRE(car(cdr(cdr(cdr(cdr(cdr(res)))))) == False);
+
+  istringstream too_big{"99999999999999999999999"};
+  REQUIRE(typeOf(doRead(too_big)) == Value::Type::BIGNUM);
+}
+
+TEST_CASE("characters can be named and strings can hold escapes"){
+  istringstream ss{"(#\\newline #\\space #\\( #\\  \"a\\n\\\"b\\\\\")"};
+  auto res = doRead(ss);
+  REQUIRE(characterValue(car(res)) == '\n');
+  REQUIRE(characterValue(car(cdr(res))) == ' ');
+  REQUIRE(characterValue(car(cdr(cdr(res)))) == '(');
+  REQUIRE(characterValue(car(cdr(cdr(cdr(res))))) == ' ');
+  REQUIRE(strcmp(car(cdr(cdr(cdr(cdr(res)))))->str.str, "a\n\"b\\") == 0);
+
+  istringstream unknown_name{"#\\bell"};
+  REQUIRE_THROWS_AS(doRead(unknown_name), LexingError);
+  istringstream unknown_escape{"\"\\q\""};
+  REQUIRE_THROWS_AS(doRead(unknown_escape), LexingError);
+  istringstream bad_number{"12ab"};
+  REQUIRE_THROWS_AS(doRead(bad_number), LexingError);
+}
+
+TEST_CASE("every scan level stops at the same bytes"){
+  // each byte value after a run of constituents long enough for the widest
+  // scanner, then again just short of the end of the input
+  vector<string> inputs;
+  for(int ch = 0; ch < 256; ++ch){
+    inputs.push_back(string(40, 'a') + static_cast<char>(ch) + string(40, 'b'));
+    inputs.push_back(string(40, 'a') + static_cast<char>(ch));
+  }
+  inputs.push_back(string(100, 'x'));
+
+  setScanLevel(ScanLevel::SCALAR);
+  vector<size_t> atoms, strings;
+  for(auto& input : inputs){
+    const char* end = input.data() + input.size();
+    atoms.push_back(skipAtom(input.data(), end) - input.data());
+    strings.push_back(skipStringBody(input.data(), end) - input.data());
+  }
+  REQUIRE(atoms[2 * '('] == 40);
+  REQUIRE(atoms[2 * '-'] == 81);
+  REQUIRE(strings[2 * '"'] == 40);
+  REQUIRE(strings[2 * '('] == 81);
+
+  for(auto level : {ScanLevel::SSE2, ScanLevel::AVX2}){
+    setScanLevel(level);
+    for(size_t i = 0; i < inputs.size(); ++i){
+      const char* end = inputs[i].data() + inputs[i].size();
+      REQUIRE(static_cast<size_t>(skipAtom(inputs[i].data(), end) - inputs[i].data()) == atoms[i]);
+      REQUIRE(static_cast<size_t>(skipStringBody(inputs[i].data(), end) - inputs[i].data()) == strings[i]);
+    }
+  }
+  setScanLevel(bestScanLevel());
+}
+
+TEST_CASE("long and deeply nested lists don't recurse"){
+  string flat = "(";
+  for(int i = 0; i < 1000000; ++i){
+    flat += "1 ";
+  }
+  flat += ")";
+  MemorySource long_list{flat.data(), flat.size()};
+  Reader reader{long_list};
+  size_t length = 0;
+  for(Value* rest = reader.next(); rest != EmptyList; rest = cdr(rest)){
+    ++length;
+  }
+  REQUIRE(length == 1000000);
+
+  string deep = string(200000, '(') + "'x" + string(200000, ')');
+  MemorySource deep_list{deep.data(), deep.size()};
+  Reader other{deep_list};
+  Value* res = other.next();
+  size_t depth = 0;
+  for(; typeOf(car(res)) == Value::Type::PAIR; res = car(res)){
+    ++depth;
+  }
+  REQUIRE(depth == 200000);
+  REQUIRE(car(res) == getInternedSymbol("quote"));
+  REQUIRE(car(cdr(res)) == getInternedSymbol("x"));
+}
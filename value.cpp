@@ -1,9 +1,12 @@
+#include <algorithm>
+#include <cstdint>
 #include <cstring>
-#include <iostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "value.hpp"
+#include "number.hpp"
 
 using namespace std;
 
@@ -12,94 +15,180 @@ namespace { // unnamed namespace
 
 vector<Value*> SymbolTable;
 
+// Symbols are found through an open addressing index over SymbolTable,
+// probed linearly and kept at most half full. Each symbol carries the hash
+// of its name, so growing the index and most mismatches never touch the
+// characters.
+vector<Value*> SymbolIndex(256, nullptr);
+InternStatistics InternStats{0, 256, 0, 0, 0};
+
+// FNV-1a
+size_t hashName(const char* name, size_t length){
+  uint64_t hash = 14695981039346656037ull;
+  for(size_t i = 0; i < length; ++i){
+    hash ^= static_cast<unsigned char>(name[i]);
+    hash *= 1099511628211ull;
+  }
+  return static_cast<size_t>(hash);
+}
+
+void insertIntoIndex(vector<Value*>& index, Value* symbol){
+  size_t mask = index.size() - 1;
+  size_t idx = symbol->symbol.hash & mask;
+  while(index[idx]){
+    idx = (idx + 1) & mask;
+  }
+  index[idx] = symbol;
+}
+
+void growIndex(){
+  vector<Value*> index(SymbolIndex.size() * 2, nullptr);
+  for(auto symbol : SymbolTable){
+    insertIntoIndex(index, symbol);
+  }
+  SymbolIndex.swap(index);
+  InternStats.buckets = SymbolIndex.size();
+}
+
 } // end unnamed namespace
 
-Value::Sym::Sym(const char* n) {
-  name = new char[strlen(n)]();
-  strcpy(name, n);
+void* Value::operator new(size_t size, gc::Tenured) {
+  return gc::allocateTenuredValue(size);
+}
+
+void Value::operator delete(void* ptr) {
+  gc::freeValue(ptr);
+}
+
+void Value::operator delete(void* ptr, gc::Tenured) {
+  gc::freeValue(ptr);
+}
+
+Value::Sym::Sym(const char* n, size_t len, size_t h) : length{len}, hash{h} {
+  name = new char[len + 1]();
+  memcpy(name, n, len);
+}
+
+Value::Str::Str(const char* s, size_t length) {
+  str = new char[length + 1]();
+  memcpy(str, s, length);
 }
 
 Value::Str::Str(const char* s) {
-  str = new char[strlen(s)]();
+  str = new char[strlen(s) + 1]();
   strcpy(str, s);
 }
 
 Value* getInternedSymbol(const string& name) {
-  auto symbol_itr = find_if(begin(SymbolTable), end(SymbolTable),
-                            [&](Value* v){ 
-                              return !strcmp(v->symbol.name, name.c_str());
-                            });
-  if(symbol_itr == end(SymbolTable)){
-    // add new symbol
-    Value::Sym sym(name.c_str());
-    Value* symbol = new Value(sym);
-    SymbolTable.push_back(symbol);
-    symbol_itr = SymbolTable.end() - 1;
+  return getInternedSymbol(name.data(), name.size());
+}
+
+Value* getInternedSymbol(const char* name, size_t length) {
+  size_t hash = hashName(name, length);
+  size_t mask = SymbolIndex.size() - 1;
+  size_t probes = 1;
+  size_t idx = hash & mask;
+  for(; SymbolIndex[idx]; idx = (idx + 1) & mask, ++probes){
+    auto& sym = SymbolIndex[idx]->symbol;
+    if(sym.hash == hash && sym.length == length && !memcmp(sym.name, name, length)){
+      break;
+    }
+  }
+  ++InternStats.lookups;
+  InternStats.probes += probes;
+  InternStats.max_probe = max(InternStats.max_probe, probes);
+  if(SymbolIndex[idx]){
+    return SymbolIndex[idx];
+  }
+
+  // add new symbol
+  Value::Sym sym(name, length, hash);
+  // symbols are compared and hashed by address, so they can't move
+  Value* symbol = new(gc::tenured) Value(sym);
+  SymbolTable.push_back(symbol);
+  ++InternStats.symbols;
+  if(SymbolTable.size() * 2 > SymbolIndex.size()){
+    growIndex();
+  } else {
+    SymbolIndex[idx] = symbol;
   }
-  return *symbol_itr;
+  return symbol;
 }
 
-void print(Value* value) {
+const vector<Value*>& internedSymbols() {
+  return SymbolTable;
+}
+
+InternStatistics internStatistics() {
+  return InternStats;
+}
+
+void print(Value* value, OutputPort& port) {
   if(value == EmptyList){
-    cout << "()";
+    port.write("()");
     return;
   }
   if(!value){
     return;
   }
-  switch(value->type){
+  switch(typeOf(value)){
     case Value::Type::FIXNUM:{
-      cout << value->fixnum;
+      port.writeFixnum(fixnumValue(value));
+    } break;
+    case Value::Type::BIGNUM:{
+      port.write(value->bignum->toDecimal());
     } break;
     case Value::Type::BOOLEAN:{
-      if(value->boolean){
-        cout << "True";
+      if(value == True){
+        port.write("True");
       } else {
-        cout << "False";
+        port.write("False");
       }
     } break;
     case Value::Type::CHARACTER:{
-      cout << "#\\" << value->character;
+      port.write("#\\");
+      port.put(characterValue(value));
     } break;
     case Value::Type::STRING:{
-      cout << "\"" << value->str.str << "\"";
+      port.put('"');
+      port.write(value->str.str);
+      port.put('"');
     } break;
     case Value::Type::PAIR:{
-      cout << "(";
-      print(value->car);
-      for(Value* cdr = value->cdr; cdr; cdr = cdr->cdr){
-        if(cdr->type != Value::Type::PAIR){
-          cout << " . ";
-          print(cdr);
+      port.put('(');
+      print(car(value), port);
+      for(Value* rest = cdr(value); rest && rest != EmptyList; rest = cdr(rest)){
+        if(typeOf(rest) != Value::Type::PAIR){
+          port.write(" . ");
+          print(rest, port);
           break;
         }
-        cout << " ";
-        print(cdr->car);
+        port.put(' ');
+        print(car(rest), port);
       }
-      cout << ")";
+      port.put(')');
     } break;
     case Value::Type::SYMBOL:{
-      cout << value->symbol.name;
+      port.write(value->symbol.name, value->symbol.length);
     } break;
     case Value::Type::PROCEDURE:{
-      cout << "#<procedure>";
+      port.write("#<procedure>");
     } break;
     case Value::Type::SPECIAL_FORM:{
-      cout << "#<syntax>";
+      port.write("#<syntax>");
+    } break;
+    case Value::Type::CODE:{
+      port.write("#<code>");
     } break;
   }
 }
 
 Value* reverse(Value* list) {
   Value* result_list = EmptyList;
-  for(Value* ptr = list; ptr != EmptyList; ptr = ptr->cdr){
-    result_list = new Value(ptr->car, result_list);
+  for(Value* ptr = list; ptr != EmptyList; ptr = cdr(ptr)){
+    result_list = makePair(car(ptr), result_list);
   }
   return result_list;
 }
 
-Value True{true};
-Value False{false};
-Value* EmptyList{new Value{nullptr, nullptr}};
 }
-
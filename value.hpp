@@ -1,17 +1,30 @@
 #pragma once
 
+#include <cassert>
+#include <cstdint>
 #include <string>
+#include <vector>
+
+#include "gc.hpp"
+#include "port.hpp"
 
 namespace crisp{
 
 struct Environment;
+struct Code;
+class Bignum;
+class Compiler;
 class Value;
 
-using PrimitiveProcedure = Value*(*)(Environment* envt);
-using SpecialForm = Value*(*)(Value*, Environment*);
+// Primitives get their arguments as a span of argc values, already checked
+// against the arity they were declared with. The span lives on the VM
+// stack, so it's only valid until the primitive calls back into eval.
+using PrimitiveProcedure = Value*(*)(Value** args, size_t argc);
+// special forms are handled when compiling, see compile.hpp
+using SpecialForm = void(*)(Compiler& compiler, Value* input, bool tail);
 class Value {
   public:
-    enum class Type {
+    enum class Type : uint8_t {
       FIXNUM,
       BOOLEAN,
       CHARACTER,
@@ -19,60 +32,205 @@ class Value {
       PAIR,
       SYMBOL,
       PROCEDURE,
-      SPECIAL_FORM
+      SPECIAL_FORM,
+      CODE,
+      BIGNUM
     };
+    // only for the kinds that have a header, use typeOf
     Type type;
+    // kept next to the type rather than in the procedure fields, which
+    // keeps every value down to a header word and three pointers
+    bool is_primitive; // for procedures, if true the procedure is primitive
+    bool variadic = false; // for primitives, if true extra arguments are allowed
+    uint16_t arity = 0;    // for primitives, the number of required arguments
     struct Str{
       char* str;
       Str(const char* s);
+      Str(const char* s, size_t length);
     };
     struct Sym{
       char* name;
-      Sym(const char* n);
+      size_t length;
+      size_t hash; // of the name, kept for the intern table
+      Sym(const char* n, size_t len, size_t h);
     };
     union {
-      long fixnum;
-      bool boolean;
-      char character;
       Str str;
-      struct { // for pair
-        Value* car;
-        Value* cdr;
-      };
       Sym symbol;
       struct { // for procedures
-        Value* args; // list of arguments names for this procedure
+        Value* args; // list of arguments names for compiled procedures
         Environment* envt;  // closure-style environment for this procedure
-        bool is_primitive; // if true, the procedure is primitive
         union {
           PrimitiveProcedure prim_procedure; // for primitive procedures
-          Value* body; // for regular procedures
+          Value* body; // for regular procedures, the compiled CODE
         };
       };
       SpecialForm special_form;
+      Code* code;
+      Bignum* bignum; // only for integers that don't fit in a fixnum
     };
 
-    explicit Value(long n) : type{Type::FIXNUM}, fixnum{n} {}
-    explicit Value(bool b) : type{Type::BOOLEAN}, boolean{b} {}
-    explicit Value(char c) : type{Type::CHARACTER}, character{c} {}
-    explicit Value(Str s) : type{Type::STRING}, str(s) {}
-    explicit Value(Value* a, Value* d) : type{Type::PAIR}, car{a}, cdr{d} {}
-    explicit Value(Sym s) : type{Type::SYMBOL}, symbol(s) {}
-    explicit Value(Value* a, Environment* e, PrimitiveProcedure p)
-        : type{Type::PROCEDURE}, args{a}, envt{e}, is_primitive{true}, prim_procedure{p} {}
+    explicit Value(Str s) : type{Type::STRING}, is_primitive{false}, str(s) {
+      gc::registerFinalizer(this);
+    }
+    explicit Value(Sym s) : type{Type::SYMBOL}, is_primitive{false}, symbol(s) {}
+    explicit Value(PrimitiveProcedure p, uint16_t n, bool v = false)
+        : type{Type::PROCEDURE}, is_primitive{true}, variadic{v}, arity{n},
+          args{nullptr}, envt{nullptr}, prim_procedure{p} {}
     explicit Value(Value* a, Environment* e, Value* b)
-        : type{Type::PROCEDURE}, args{a}, envt{e}, is_primitive{false}, body{b} {}
-    explicit Value(SpecialForm s) : type{Type::SPECIAL_FORM}, special_form{s} {}
-    Value() : type{Type::PAIR} {}
+        : type{Type::PROCEDURE}, is_primitive{false}, args{a}, envt{e}, body{b} {}
+    explicit Value(SpecialForm s) : type{Type::SPECIAL_FORM}, is_primitive{false}, special_form{s} {}
+    explicit Value(Code* c) : type{Type::CODE}, is_primitive{false}, code{c} {
+      gc::registerFinalizer(this);
+    }
+    // use makeInteger, which keeps integers that fit as fixnums
+    explicit Value(Bignum* b) : type{Type::BIGNUM}, is_primitive{false}, bignum{b} {
+      gc::registerFinalizer(this);
+    }
+
+    // values are owned by the collector, see gc.hpp
+    static void* operator new(size_t size) {
+      return gc::allocateValue(size);
+    }
+    static void* operator new(size_t size, gc::Tenured);
+    static void operator delete(void* ptr);
+    static void operator delete(void* ptr, gc::Tenured);
   private:
 };
 
+// Pairs outnumber everything else, so they're just their two fields, with
+// no header: the word that points to one says it's a pair.
+struct Pair{
+  Value* car;
+  Value* cdr;
+};
+
+struct InternStatistics{
+  size_t symbols;   // symbols interned since startup
+  size_t buckets;   // size of the hash index
+  size_t lookups;   // calls to getInternedSymbol
+  size_t probes;    // buckets looked at over all lookups
+  size_t max_probe; // longest probe sequence seen
+};
+
+static_assert(sizeof(Value) <= 4 * sizeof(void*), "values should fit in four words");
+static_assert(sizeof(Pair) == 2 * sizeof(void*), "pairs should be two words");
+
+/***** Tagged Words *****/
+// A Value* is a tagged word, and only sometimes a pointer to a Value. Its
+// low bits say what it holds:
+//
+//   xx1  a fixnum, in the rest of the word
+//   000  a pointer to a Value, whose type field says what it is; null is
+//        still an unspecified value
+//   010  a pointer to a Pair
+//   110  an immediate: the empty list, a boolean or a character, with which
+//        one in the next two bits and a character's code above them
+//
+// Fixnums, booleans, characters and the empty list take no memory, and
+// each of them is equal to another only if the words are. Everything the
+// collector allocates is 16 byte aligned, which leaves the tag bits free.
+// Only values with a header can be dereferenced, so go through typeOf, car
+// and cdr and friends for anything else.
+constexpr uintptr_t FixnumTag = 1;
+constexpr uintptr_t TagMask = 7;
+constexpr uintptr_t PairTag = 2;
+constexpr uintptr_t ImmediateTag = 6;
+constexpr uintptr_t EmptyListWord = 0x06;
+constexpr uintptr_t FalseWord = 0x0e;
+constexpr uintptr_t TrueWord = 0x16;
+constexpr uintptr_t CharacterTag = 0x1e;
+constexpr unsigned CharacterShift = 8;
+static_assert(gc::HeapTagMask == TagMask - PairTag, "the collector has to tell heap words apart");
+
+// the range of a fixnum, one bit short of a long
+constexpr long FixnumMin = -(1l << 62);
+constexpr long FixnumMax = (1l << 62) - 1;
+
+inline uintptr_t wordOf(const Value* value){
+  return reinterpret_cast<uintptr_t>(value);
+}
+
+inline Value* valueOf(uintptr_t word){
+  return reinterpret_cast<Value*>(word);
+}
+
+inline bool isFixnum(const Value* value){
+  return wordOf(value) & FixnumTag;
+}
+
+// n has to be in range, makeInteger takes any long
+inline Value* makeFixnum(long n){
+  assert(n >= FixnumMin && n <= FixnumMax && "fixnum out of range");
+  return valueOf((static_cast<uintptr_t>(n) << 1) | FixnumTag);
+}
+
+inline long fixnumValue(const Value* value){
+  return static_cast<long>(wordOf(value)) >> 1;
+}
+
+inline Value* makeCharacter(char c){
+  return valueOf((uintptr_t{static_cast<unsigned char>(c)} << CharacterShift) | CharacterTag);
+}
+
+inline char characterValue(const Value* value){
+  return static_cast<char>(wordOf(value) >> CharacterShift);
+}
+
+inline Pair* pairOf(Value* pair){
+  assert((wordOf(pair) & TagMask) == PairTag && "not a pair");
+  return reinterpret_cast<Pair*>(wordOf(pair) - PairTag);
+}
+
+inline Value*& car(Value* pair){
+  return pairOf(pair)->car;
+}
+
+inline Value*& cdr(Value* pair){
+  return pairOf(pair)->cdr;
+}
+
+// new pairs are young, so filling them in needs no write barrier
+inline Value* makePair(Value* car, Value* cdr){
+  auto pair = static_cast<Pair*>(gc::allocatePair(sizeof(Pair)));
+  pair->car = car;
+  pair->cdr = cdr;
+  return valueOf(reinterpret_cast<uintptr_t>(pair) | PairTag);
+}
+
+// The empty list is typed as a pair, as it always has been, so code that
+// takes a list checks for it before taking a car or cdr.
+inline Value::Type typeOf(const Value* value){
+  static const Value::Type Immediates[] = {
+    Value::Type::PAIR, Value::Type::BOOLEAN, Value::Type::BOOLEAN, Value::Type::CHARACTER
+  };
+  uintptr_t word = wordOf(value);
+  if(word & FixnumTag){
+    return Value::Type::FIXNUM;
+  }
+  switch(word & TagMask){
+    case PairTag: return Value::Type::PAIR;
+    case ImmediateTag: return Immediates[(word >> 3) & 3];
+    default: return value->type;
+  }
+}
+
 Value* getInternedSymbol(const std::string& name);
-void print(Value* val);
+Value* getInternedSymbol(const char* name, size_t length);
+const std::vector<Value*>& internedSymbols();
+InternStatistics internStatistics();
+// writes val to port, buffered until the port is flushed
+void print(Value* val, OutputPort& port = standardOutput());
 Value* reverse(Value* list);
 
-extern Value True;
-extern Value False;
-extern Value* EmptyList;
+// constants rather than objects, so they're the same in every translation
+// unit before anything else is initialized
+Value* const EmptyList = valueOf(EmptyListWord);
+Value* const True = valueOf(TrueWord);
+Value* const False = valueOf(FalseWord);
+
+inline Value* makeBoolean(bool b){
+  return b ? True : False;
+}
 
 }
@@ -0,0 +1,370 @@
+#include <algorithm>
+#include <vector>
+
+#include "vm.hpp"
+#include "compile.hpp"
+#include "value.hpp"
+#include "eval.hpp"
+
+using namespace std;
+
+namespace crisp{
+namespace { // unnamed namespace
+
+// A frame is pushed for every compiled procedure (or top level form) that's
+// running. Its stack slots start at base, which holds the procedure itself
+// so it stays alive while its code runs.
+struct Frame{
+  Code* code;
+  const uint32_t* pc;
+  size_t base;
+};
+
+vector<Value*> Stack;
+gc::RootVector StackRoots{Stack};
+vector<Frame> Frames;
+// the environment each frame runs in, kept apart so the collector can see it
+vector<Environment*> Environments;
+gc::EnvironmentRootVector EnvironmentRoots{Environments};
+
+Value* checkProcedure(Value* proc){
+  if(!proc || typeOf(proc) != Value::Type::PROCEDURE){
+    throw EvaluationError("Cannot call something that isn't a procedure.");
+  }
+  return proc;
+}
+
+// Binds the argc values on top of the stack to the procedure's parameters.
+// Compiled procedures get a frame with a slot per local, the parameters
+// first, so the arguments are copied straight across; only a procedure
+// with a rest parameter gets a list, of just the extras, consed from the
+// last one back. The frame is brand new, so it's young and needs no write
+// barrier.
+Environment* bindArguments(Value* proc, size_t argc){
+  Code* code = proc->body->code;
+  if(argc < code->required){
+    throw EvaluationError("Missing required arguments.");
+  }
+  if(argc > code->required && !code->rest){
+    throw EvaluationError("Too many arguments.");
+  }
+  Environment* envt = Environment::frame(proc->envt, proc->body);
+  Value** args = Stack.data() + Stack.size() - argc;
+  Value** slots = envt->slots();
+  copy(args, args + code->required, slots);
+  if(code->rest){
+    Value* rest = EmptyList;
+    for(size_t i = argc; i > code->required; --i){
+      rest = makePair(args[i - 1], rest);
+    }
+    slots[code->required] = rest;
+  }
+  return envt;
+}
+
+// primitives take their arguments straight off the stack
+Value* callPrimitive(Value* proc, size_t argc){
+  if(argc < proc->arity){
+    throw EvaluationError("Missing required arguments.");
+  }
+  if(argc > proc->arity && !proc->variadic){
+    throw EvaluationError("Too many arguments.");
+  }
+  return proc->prim_procedure(Stack.data() + Stack.size() - argc, argc);
+}
+
+// The global binding of the symbol in code's constants at index, looked up
+// the first time and cached after that. Bindings don't move, and the
+// compiler only emits global instructions where nothing can shadow one.
+Value** globalCell(Code* code, uint32_t index){
+  Value**& cell = code->cells[index];
+  if(!cell){
+    // only found bindings are cached, a later define makes the binding
+    cell = GlobalEnvironment.findBinding(code->constants[index]);
+  }
+  return cell;
+}
+
+Value* pop(){
+  Value* value = Stack.back();
+  Stack.pop_back();
+  return value;
+}
+
+// Runs until the frame at index entry returns. Dispatch is threaded through
+// a table of label addresses, so every instruction ends in its own indirect
+// jump.
+Value* run(size_t entry){
+  static void* const dispatch[] = {
+    &&op_const,
+    &&op_global_ref,
+    &&op_local_ref,
+    &&op_envt_ref,
+    &&op_global_define,
+    &&op_envt_define,
+    &&op_global_set,
+    &&op_local_set,
+    &&op_envt_set,
+    &&op_pop,
+    &&op_jump,
+    &&op_jump_if_false,
+    &&op_closure,
+    &&op_call,
+    &&op_tail_call,
+    &&op_return,
+    &&op_cons,
+    &&op_append,
+    &&op_far_ref,
+    &&op_far_set,
+  };
+  static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == OpcodeCount,
+                "every opcode needs a handler");
+  Code* code;
+  const uint32_t* pc;
+  Environment* envt;
+  uint32_t instruction;
+
+#define LOAD_FRAME() \
+  do { \
+    code = Frames.back().code; \
+    pc = Frames.back().pc; \
+    envt = Environments.back(); \
+  } while(0)
+#define DISPATCH() \
+  do { \
+    instruction = *pc++; \
+    goto *dispatch[static_cast<uint8_t>(opcode(instruction))]; \
+  } while(0)
+#define CONSTANT() (code->constants[operand(instruction)])
+
+  LOAD_FRAME();
+  DISPATCH();
+
+op_const:
+  Stack.push_back(CONSTANT());
+  DISPATCH();
+
+op_global_ref:{
+  auto bdg = globalCell(code, operand(instruction));
+  if(!bdg || !*bdg){
+    throw EvaluationError("Cannot evaluate undefined symbol");
+  }
+  Stack.push_back(*bdg);
+} DISPATCH();
+
+op_local_ref:{
+  Environment* frame = envt;
+  for(uint32_t d = depth(operand(instruction)); d; --d){
+    frame = frame->parent;
+  }
+  Value* local = frame->slots()[slot(operand(instruction))];
+  if(!local){
+    throw EvaluationError("Cannot evaluate undefined symbol");
+  }
+  Stack.push_back(local);
+} DISPATCH();
+
+op_envt_ref:{
+  auto bdg = envt->getBinding(CONSTANT());
+  if(!bdg){
+    throw EvaluationError("Cannot evaluate undefined symbol");
+  }
+  Stack.push_back(bdg);
+} DISPATCH();
+
+op_global_define:
+  GlobalEnvironment.setBinding(CONSTANT(), pop());
+  Stack.push_back(nullptr);
+  DISPATCH();
+
+op_envt_define:
+  envt->setBinding(CONSTANT(), pop());
+  Stack.push_back(nullptr);
+  DISPATCH();
+
+op_global_set:{
+  auto bdg = globalCell(code, operand(instruction));
+  if(!bdg){
+    throw EvaluationError("Cannot set undefined symbol");
+  }
+  *bdg = pop();
+  gc::writeBarrier(&GlobalEnvironment, *bdg);
+  Stack.push_back(nullptr);
+} DISPATCH();
+
+op_local_set:{
+  Environment* frame = envt;
+  for(uint32_t d = depth(operand(instruction)); d; --d){
+    frame = frame->parent;
+  }
+  Value* value = pop();
+  frame->slots()[slot(operand(instruction))] = value;
+  gc::writeBarrier(frame, value);
+  Stack.push_back(nullptr);
+} DISPATCH();
+
+op_envt_set:
+  if(!envt->updateBinding(CONSTANT(), pop())){
+    throw EvaluationError("Cannot set undefined symbol");
+  }
+  Stack.push_back(nullptr);
+  DISPATCH();
+
+op_pop:
+  Stack.pop_back();
+  DISPATCH();
+
+op_jump:
+  pc = code->instructions.data() + operand(instruction);
+  DISPATCH();
+
+op_jump_if_false:
+  if(pop() == False){
+    pc = code->instructions.data() + operand(instruction);
+  }
+  DISPATCH();
+
+op_closure:{
+  Value* code_value = CONSTANT();
+  Stack.push_back(new Value(code_value->code->formals, envt, code_value));
+} DISPATCH();
+
+op_call:{
+  size_t argc = operand(instruction);
+  Frames.back().pc = pc;
+  // everything live is on the stack or in a frame
+  gc::safepoint();
+  size_t base = Stack.size() - argc - 1;
+  Value* proc = checkProcedure(Stack[base]);
+  if(proc->is_primitive){
+    Value* result = callPrimitive(proc, argc);
+    Stack.resize(base);
+    Stack.push_back(result);
+    DISPATCH();
+  }
+  envt = bindArguments(proc, argc);
+  Stack.resize(base + 1);
+  code = proc->body->code;
+  pc = code->instructions.data();
+  Frames.push_back(Frame{code, pc, base});
+  Environments.push_back(envt);
+} DISPATCH();
+
+op_tail_call:{
+  size_t argc = operand(instruction);
+  Frames.back().pc = pc;
+  gc::safepoint();
+  size_t base = Stack.size() - argc - 1;
+  Value* proc = checkProcedure(Stack[base]);
+  if(proc->is_primitive){
+    // nothing to replace, the RETURN that follows finishes the frame
+    Value* result = callPrimitive(proc, argc);
+    Stack.resize(base);
+    Stack.push_back(result);
+    DISPATCH();
+  }
+  envt = bindArguments(proc, argc);
+  size_t frame_base = Frames.back().base;
+  Stack.resize(frame_base + 1);
+  Stack[frame_base] = proc;
+  code = proc->body->code;
+  pc = code->instructions.data();
+  Frames.back() = Frame{code, pc, frame_base};
+  Environments.back() = envt;
+} DISPATCH();
+
+op_return:{
+  Value* result = Stack.back();
+  Stack.resize(Frames.back().base);
+  Frames.pop_back();
+  Environments.pop_back();
+  if(Frames.size() == entry){
+    return result;
+  }
+  Stack.push_back(result);
+  LOAD_FRAME();
+} DISPATCH();
+
+op_cons:{
+  Value* cdr = pop();
+  Value* car = pop();
+  Stack.push_back(makePair(car, cdr));
+} DISPATCH();
+
+op_append:{
+  Value* tail = pop();
+  Value* list = pop();
+  // nothing can change a list, so the last one spliced can be shared
+  if(tail == EmptyList && list && typeOf(list) == Value::Type::PAIR){
+    Stack.push_back(list);
+    DISPATCH();
+  }
+  Value* head = tail;
+  Value* last = nullptr;
+  for(; list != EmptyList; list = cdr(list)){
+    if(!list || typeOf(list) != Value::Type::PAIR){
+      throw EvaluationError("Can only splice a list.");
+    }
+    // new pairs are young, or remembered until the next collection if the
+    // nursery is full, so filling in their cdrs needs no write barrier
+    Value* pair = makePair(car(list), tail);
+    if(last){
+      cdr(last) = pair;
+    } else {
+      head = pair;
+    }
+    last = pair;
+  }
+  Stack.push_back(head);
+} DISPATCH();
+
+op_far_ref:{
+  long far = fixnumValue(CONSTANT());
+  Environment* frame = envt;
+  for(uint32_t d = farDepth(far); d; --d){
+    frame = frame->parent;
+  }
+  Value* local = frame->slots()[farSlot(far)];
+  if(!local){
+    throw EvaluationError("Cannot evaluate undefined symbol");
+  }
+  Stack.push_back(local);
+} DISPATCH();
+
+op_far_set:{
+  long far = fixnumValue(CONSTANT());
+  Environment* frame = envt;
+  for(uint32_t d = farDepth(far); d; --d){
+    frame = frame->parent;
+  }
+  Value* value = pop();
+  frame->slots()[farSlot(far)] = value;
+  gc::writeBarrier(frame, value);
+  Stack.push_back(nullptr);
+} DISPATCH();
+
+#undef CONSTANT
+#undef DISPATCH
+#undef LOAD_FRAME
+}
+
+} // end unnamed namespace
+
+Value* execute(Value* code, Environment* envt){
+  size_t stack_size = Stack.size();
+  size_t entry = Frames.size();
+  Stack.push_back(code);
+  Frames.push_back(Frame{code->code, code->code->instructions.data(), stack_size});
+  Environments.push_back(envt);
+  try{
+    return run(entry);
+  } catch(...){
+    // unwind anything the failed evaluation left behind
+    Stack.resize(stack_size);
+    Frames.resize(entry);
+    Environments.resize(entry);
+    throw;
+  }
+}
+
+}
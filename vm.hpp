@@ -0,0 +1,12 @@
+#pragma once
+
+#include "value.hpp"
+#include "eval.hpp"
+
+namespace crisp{
+
+/***** Functions *****/
+// run compiled code (as returned by compile) in the given environment
+Value* execute(Value* code, Environment* envt);
+
+}